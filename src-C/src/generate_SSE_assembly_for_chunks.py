@@ -50,6 +50,16 @@ def offset (i, j, N):
 
   return row_major_index(i, j, N)
 
+def loadA (r, c, i, k, A):
+  """Loads A(r,c) of the basic block A(i,k) into all 4 elements of register A."""
+
+  if broadcast:
+    # Broadcast from the matrix.
+    print("  vbroadcastss 0x%x(%%r13), %s" % ((row_major_index(r, c, 4)+offset(i, k, 4)*16)*4, A))
+  else:
+    # Load from the dilated matrix.
+    print("  movaps 0x%x(%%r13), %s" % (row_major_index(r, c, 4)*4*4+offset(i, k, 4)*64*4, A))
+
 def clearC (i, j):
   """Clears the C(i,j) accumulator registers."""
 
@@ -142,7 +152,7 @@ def block_product (i, k, j):
   norm = SSERegister(log, "norm")
 
   print("  # Check norm of product ||A(%d,%d)||*||B(%d,%d)||." % (i+1, k+1, k+1, j+1))
-  print("#if SPAMM_NORM_TYPE == float")
+  print("#if SIZEOF_NORM == SIZEOF_FLOAT")
   print("  movss 0x%x(%%r10), %s" % (row_major_index(i, k, 4)*4, norm))
   print("  mulss 0x%x(%%r11), %s" % (row_major_index(k, j, 4)*4, norm))
 
@@ -151,12 +161,12 @@ def block_product (i, k, j):
   # At&T syntax, which means that the order of operand 1 and 2 are the
   # opposite which includes the comparison instruction.
   print("  comiss %s, %s" % (tolerance, norm))
-  print("#elif SPAMM_NORM_TYPE == double")
+  print("#elif SIZEOF_NORM == SIZEOF_DOUBLE")
   print("  movsd 0x%x(%%r10), %s" % (row_major_index(i, k, 4)*8, norm))
   print("  mulsd 0x%x(%%r11), %s" % (row_major_index(k, j, 4)*8, norm))
   print("  comisd %s, %s" % (tolerance, norm))
   print("#else")
-  print("#error \"Unknown SPAMM_NORM_TYPE\"")
+  print("#error \"Unknown SIZEOF_NORM\"")
   print("#endif")
   print("  jbe jump_%d" % (block_counter.get()))
 
@@ -178,9 +188,9 @@ def block_product (i, k, j):
   A12 = SSERegister(log, "A12")
   A13 = SSERegister(log, "A13")
 
-  print("  movaps 0x%x(%%r13), %s" % (row_major_index(0, 0, 4)*4*4+offset(i, k, 4)*64*4, A11))
-  print("  movaps 0x%x(%%r13), %s" % (row_major_index(0, 1, 4)*4*4+offset(i, k, 4)*64*4, A12))
-  print("  movaps 0x%x(%%r13), %s" % (row_major_index(0, 2, 4)*4*4+offset(i, k, 4)*64*4, A13))
+  loadA(0, 0, i, k, A11)
+  loadA(0, 1, i, k, A12)
+  loadA(0, 2, i, k, A13)
   print("  mulps %s, %s" % (B1, A11))
   print("  mulps %s, %s" % (B2, A12))
   print("  addps %s, %s" % (A11, C1))
@@ -188,91 +198,91 @@ def block_product (i, k, j):
   A11.release()
   A14 = SSERegister(log, "A14")
 
-  print("  movaps 0x%x(%%r13), %s" % (row_major_index(0, 3, 4)*4*4+offset(i, k, 4)*64*4, A14))
+  loadA(0, 3, i, k, A14)
   print("  mulps %s, %s" % (B3, A13))
   print("  addps %s, %s" % (A12, C1))
 
   A12.release()
   A21 = SSERegister(log, "A21")
 
-  print("  movaps 0x%x(%%r13), %s" % (row_major_index(1, 0, 4)*4*4+offset(i, k, 4)*64*4, A21))
+  loadA(1, 0, i, k, A21)
   print("  mulps %s, %s" % (B4, A14))
   print("  addps %s, %s" % (A13, C1))
 
   A13.release()
   A22 = SSERegister(log, "A22")
 
-  print("  movaps 0x%x(%%r13), %s" % (row_major_index(1, 1, 4)*4*4+offset(i, k, 4)*64*4, A22))
+  loadA(1, 1, i, k, A22)
   print("  mulps %s, %s" % (B1, A21))
   print("  addps %s, %s" % (A14, C1))
 
   A14.release()
   A23 = SSERegister(log, "A23")
 
-  print("  movaps 0x%x(%%r13), %s" % (row_major_index(1, 2, 4)*4*4+offset(i, k, 4)*64*4, A23))
+  loadA(1, 2, i, k, A23)
   print("  mulps %s, %s" % (B2, A22))
   print("  addps %s, %s" % (A21, C2))
 
   A21.release()
   A24 = SSERegister(log, "A24")
 
-  print("  movaps 0x%x(%%r13), %s" % (row_major_index(1, 3, 4)*4*4+offset(i, k, 4)*64*4, A24))
+  loadA(1, 3, i, k, A24)
   print("  mulps %s, %s" % (B3, A23))
   print("  addps %s, %s" % (A22, C2))
 
   A22.release()
   A31 = SSERegister(log, "A31")
 
-  print("  movaps 0x%x(%%r13), %s" % (row_major_index(2, 0, 4)*4*4+offset(i, k, 4)*64*4, A31))
+  loadA(2, 0, i, k, A31)
   print("  mulps %s, %s" % (B4, A24))
   print("  addps %s, %s" % (A23, C2))
 
   A23.release()
   A32 = SSERegister(log, "A32")
 
-  print("  movaps 0x%x(%%r13), %s" % (row_major_index(2, 1, 4)*4*4+offset(i, k, 4)*64*4, A32))
+  loadA(2, 1, i, k, A32)
   print("  mulps %s, %s" % (B1, A31))
   print("  addps %s, %s" % (A24, C2))
 
   A24.release()
   A33 = SSERegister(log, "A33")
 
-  print("  movaps 0x%x(%%r13), %s" % (row_major_index(2, 2, 4)*4*4+offset(i, k, 4)*64*4, A33))
+  loadA(2, 2, i, k, A33)
   print("  mulps %s, %s" % (B2, A32))
   print("  addps %s, %s" % (A31, C3))
 
   A31.release()
   A34 = SSERegister(log, "A34")
 
-  print("  movaps 0x%x(%%r13), %s" % (row_major_index(2, 3, 4)*4*4+offset(i, k, 4)*64*4, A34))
+  loadA(2, 3, i, k, A34)
   print("  mulps %s, %s" % (B3, A33))
   print("  addps %s, %s" % (A32, C3))
 
   A32.release()
   A41 = SSERegister(log, "A41")
 
-  print("  movaps 0x%x(%%r13), %s" % (row_major_index(3, 0, 4)*4*4+offset(i, k, 4)*64*4, A41))
+  loadA(3, 0, i, k, A41)
   print("  mulps %s, %s" % (B4, A34))
   print("  addps %s, %s" % (A33, C3))
 
   A33.release()
   A42 = SSERegister(log, "A42")
 
-  print("  movaps 0x%x(%%r13), %s" % (row_major_index(3, 1, 4)*4*4+offset(i, k, 4)*64*4, A42))
+  loadA(3, 1, i, k, A42)
   print("  mulps %s, %s" % (B1, A41))
   print("  addps %s, %s" % (A34, C3))
 
   A34.release()
   A43 = SSERegister(log, "A43")
 
-  print("  movaps 0x%x(%%r13), %s" % (row_major_index(3, 2, 4)*4*4+offset(i, k, 4)*64*4, A43))
+  loadA(3, 2, i, k, A43)
   print("  mulps %s, %s" % (B2, A42))
   print("  addps %s, %s" % (A41, C4))
 
   A41.release()
   A44 = SSERegister(log, "A44")
 
-  print("  movaps 0x%x(%%r13), %s" % (row_major_index(3, 3, 4)*4*4+offset(i, k, 4)*64*4, A44))
+  loadA(3, 3, i, k, A44)
   print("  mulps %s, %s" % (B3, A43))
   print("  addps %s, %s" % (A42, C4))
   print("  mulps %s, %s" % (B4, A44))
@@ -303,6 +313,12 @@ def main ():
       dest = "functionName",
       default = "spamm_stream_kernel")
 
+  parser.add_argument("--broadcast",
+      help = "load the elements of A with AVX broadcasts instead of from the "
+      + "dilated matrix [default: %(default)s]",
+      action = "store_true",
+      default = False)
+
   parser.add_argument("--debug",
       help = "print out a lot of debugging information [default: %(default)s]",
       action = "store_true",
@@ -314,6 +330,9 @@ def main ():
   global log
   global block_counter
   global tolerance
+  global broadcast
+
+  broadcast = options.broadcast
 
   log = logging.getLogger("generate assembly")
   log.setLevel(logging.DEBUG)
@@ -379,6 +398,13 @@ def main ():
   print("")
   print("# Include some data type sizes")
   print("#include \"config.h\"")
+  print("")
+  print("# The size of the norms, see spamm_norm_t.")
+  print("#ifdef SPAMM_NORM_TYPE_DOUBLE")
+  print("#define SIZEOF_NORM SIZEOF_DOUBLE")
+  print("#else")
+  print("#define SIZEOF_NORM SIZEOF_FLOAT")
+  print("#endif")
 
   print("")
   print("# Define some variables.")
@@ -447,7 +473,10 @@ def main ():
   # Some preparations.
   print("")
   print("  # Load pointers to stream matrix blocks.")
-  print("  mov 6*8(chunk_A), %r10 # A_dilated.")
+  if broadcast:
+    print("  mov 5*8(chunk_A), %r10 # A.")
+  else:
+    print("  mov 6*8(chunk_A), %r10 # A_dilated.")
   print("  mov 5*8(chunk_B), %r11 # B.")
   print("  mov 5*8(chunk_C), %r12 # C.")
   print("  lea (chunk_A, %r10), %r10")
@@ -481,9 +510,9 @@ def main ():
   print("  lea (chunk_A, %r10), %r10")
   print("  lea (chunk_B, %r11), %r11")
   print("  lea (chunk_C, %r12), %r12")
-  print("  lea (%r10, %r9, SIZEOF_FLOAT), %r10")
-  print("  lea (%r11, %r9, SIZEOF_FLOAT), %r11")
-  print("  lea (%r12, %r9, SIZEOF_FLOAT), %r12")
+  print("  lea (%r10, %r9, SIZEOF_NORM), %r10")
+  print("  lea (%r11, %r9, SIZEOF_NORM), %r11")
+  print("  lea (%r12, %r9, SIZEOF_NORM), %r12")
   print("  mov %r10, norm_A_spill")
   print("  mov %r11, norm_B_spill")
   print("  mov %r12, norm_C_spill")
@@ -517,16 +546,19 @@ def main ():
   print("  # Calculate base of norm offset. SPAMM_N_KERNEL x SPAMM_N_KERNEL blocks")
   print("  # are Z-curve ordered, and there is one norm per SPAMM_N_BLOCK x SPAMM_N_BLOCK")
   print("  # matrix.")
-  print("  imul $SPAMM_N_KERNEL_BLOCKED*SPAMM_N_KERNEL_BLOCKED*SIZEOF_FLOAT, %r10")
-  print("  imul $SPAMM_N_KERNEL_BLOCKED*SPAMM_N_KERNEL_BLOCKED*SIZEOF_FLOAT, %r11")
-  print("  imul $SPAMM_N_KERNEL_BLOCKED*SPAMM_N_KERNEL_BLOCKED*SIZEOF_FLOAT, %r12")
+  print("  imul $SPAMM_N_KERNEL_BLOCKED*SPAMM_N_KERNEL_BLOCKED*SIZEOF_NORM, %r10")
+  print("  imul $SPAMM_N_KERNEL_BLOCKED*SPAMM_N_KERNEL_BLOCKED*SIZEOF_NORM, %r11")
+  print("  imul $SPAMM_N_KERNEL_BLOCKED*SPAMM_N_KERNEL_BLOCKED*SIZEOF_NORM, %r12")
   print("  add norm_A_spill, %r10")
   print("  add norm_B_spill, %r11")
   print("  add norm_C_spill, %r12")
 
   print("")
   print("  # Calculate base of matrix offset.")
-  print("  imul $SPAMM_N_KERNEL*SPAMM_N_KERNEL*SIZEOF_FLOAT*4, %r13  # Dilated matrix A.")
+  if broadcast:
+    print("  imul $SPAMM_N_KERNEL*SPAMM_N_KERNEL*SIZEOF_FLOAT,   %r13  # Matrix A.")
+  else:
+    print("  imul $SPAMM_N_KERNEL*SPAMM_N_KERNEL*SIZEOF_FLOAT*4, %r13  # Dilated matrix A.")
   print("  imul $SPAMM_N_KERNEL*SPAMM_N_KERNEL*SIZEOF_FLOAT,   %r14  # Matrix B.")
   print("  imul $SPAMM_N_KERNEL*SPAMM_N_KERNEL*SIZEOF_FLOAT,   %r15  # Matrix C.")
   print("  add matrix_A_spill, %r13")
@@ -21,43 +21,23 @@
  * @return The square of the norm of the chunk.
  */
 spamm_norm_t
-spamm_chunk_add (const float alpha,
+spamm_chunk_add (const double alpha,
     spamm_chunk_t *A,
-    const float beta,
+    const double beta,
     spamm_chunk_t *B,
     double *const flop,
     double *const mop)
 {
-  unsigned int number_dimensions;
-
-  float *A_matrix;
-  float *B_matrix;
-
-  unsigned int N_contiguous;
-
-  unsigned int i;
-
   assert(A != NULL);
   assert(B != NULL);
+  assert(*spamm_chunk_get_precision(A) == *spamm_chunk_get_precision(B));
 
-  number_dimensions = *spamm_chunk_get_number_dimensions(B);
-
-  A_matrix = spamm_chunk_get_matrix(A);
-  B_matrix = spamm_chunk_get_matrix(B);
-
-  N_contiguous = spamm_chunk_get_N_contiguous(A);
-
-  /* Add matrices. */
-  for(i = 0; i < ipow(N_contiguous, number_dimensions); i++)
+  if(*spamm_chunk_get_precision(A) == double_precision)
   {
-    A_matrix[i] = alpha*A_matrix[i]+beta*B_matrix[i];
+    return spamm_chunk_add_double(alpha, A, beta, B, flop, mop);
   }
 
-  /* Update flop count. */
-  *flop += ipow(N_contiguous, number_dimensions);
-
-  /* Update norms. */
-  return spamm_chunk_fix(A, flop, mop);
+  return spamm_chunk_add_float(alpha, A, beta, B, flop, mop);
 }
 
 /** Add two spamm matrices. @f$ A \leftarrow \alpha A + \beta B @f$.
@@ -74,9 +54,9 @@ spamm_chunk_add (const float alpha,
  * @param mop The memory operation count
  */
 void
-spamm_recursive_add (const float alpha,
+spamm_recursive_add (const double alpha,
     struct spamm_recursive_node_t *A,
-    const float beta,
+    const double beta,
     const struct spamm_recursive_node_t *const B,
     const unsigned int number_dimensions,
     const unsigned int tier,
@@ -100,41 +80,43 @@ spamm_recursive_add (const float alpha,
         return;
       }
 
-#ifdef _OPENMP
+#ifdef SPAMM_NODE_LOCK
       omp_set_lock(&A->lock);
 #endif
 
       spamm_chunk_copy(&A->tree.chunk, beta, B->tree.chunk, use_linear_tree, flop, mop);
+      A->norm2 = spamm_chunk_get_norm2(A->tree.chunk)[0];
+      A->norm = sqrt(A->norm2);
 
-#ifdef _OPENMP
+#ifdef SPAMM_NODE_LOCK
       omp_unset_lock(&A->lock);
 #endif
     }
 
     else if(B == NULL || B->tree.chunk == NULL)
     {
-#ifdef _OPENMP
+#ifdef SPAMM_NODE_LOCK
       omp_set_lock(&A->lock);
 #endif
 
       A->norm2 = spamm_chunk_multiply_scalar(alpha, A->tree.chunk, flop, mop);
       A->norm = sqrt(A->norm2);
 
-#ifdef _OPENMP
+#ifdef SPAMM_NODE_LOCK
       omp_unset_lock(&A->lock);
 #endif
     }
 
     else
     {
-#ifdef _OPENMP
+#ifdef SPAMM_NODE_LOCK
       omp_set_lock(&A->lock);
 #endif
 
       A->norm2 = spamm_chunk_add(alpha, A->tree.chunk, beta, B->tree.chunk, flop, mop);
       A->norm = sqrt(A->norm2);
 
-#ifdef _OPENMP
+#ifdef SPAMM_NODE_LOCK
       omp_unset_lock(&A->lock);
 #endif
     }
@@ -163,7 +145,7 @@ spamm_recursive_add (const float alpha,
         return;
       }
 
-#ifdef _OPENMP
+#ifdef SPAMM_NODE_LOCK
       omp_set_lock(&A->lock);
 #endif
 
@@ -172,13 +154,13 @@ spamm_recursive_add (const float alpha,
         A->tree.child = calloc(ipow(2, number_dimensions), sizeof(struct spamm_recursive_node_t*));
       }
 
-#ifdef _OPENMP
+#ifdef SPAMM_NODE_LOCK
       omp_unset_lock(&A->lock);
 #endif
 
       for(i = 0; i < ipow(2, number_dimensions); i++)
       {
-#ifdef _OPENMP
+#ifdef SPAMM_NODE_LOCK
         omp_set_lock(&A->lock);
 #endif
 
@@ -187,7 +169,7 @@ spamm_recursive_add (const float alpha,
           A->tree.child[i] = spamm_recursive_new_node();
         }
 
-#ifdef _OPENMP
+#ifdef SPAMM_NODE_LOCK
         omp_unset_lock(&A->lock);
 #endif
 
@@ -205,7 +187,7 @@ spamm_recursive_add (const float alpha,
       }
       A->norm = sqrt(A->norm2);
 
-#ifdef _OPENMP
+#ifdef SPAMM_NODE_LOCK
       omp_unset_lock(&A->lock);
 #endif
     }
@@ -222,9 +204,9 @@ spamm_recursive_add (const float alpha,
  * @param mop The memory operation count
  */
 void
-spamm_add (const float alpha,
+spamm_add (const double alpha,
     struct spamm_matrix_t *const A,
-    const float beta,
+    const double beta,
     const struct spamm_matrix_t *const B,
     double *const flop,
     double *const mop)
@@ -236,6 +218,11 @@ spamm_add (const float alpha,
   B_pointer = NULL;
   if(B != NULL)
   {
+    if(A->precision != B->precision)
+    {
+      SPAMM_FATAL("A and B have to be of the same precision\n");
+    }
+
     B_pointer = B->recursive_tree;
   }
 
@@ -255,4 +242,17 @@ spamm_add (const float alpha,
           mop);
     }
   }
+
+  /* The trace is linear, the number of non-zeros is not. */
+  if(A->trace_valid && (B == NULL || B->trace_valid))
+  {
+    A->trace = alpha*A->trace+(B == NULL ? 0 : beta*B->trace);
+  }
+
+  else
+  {
+    A->trace_valid = 0;
+  }
+
+  A->number_nonzero_valid = 0;
 }
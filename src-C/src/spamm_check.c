@@ -8,6 +8,29 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+/** Get the square of a chunk matrix element, as it enters the norms of the
+ * chunk. In single precision, the square is rounded to float, as it is in
+ * spamm_chunk_fix_float().
+ *
+ * @param offset The offset of the element in the chunk matrix.
+ * @param chunk The chunk.
+ *
+ * @return The square of the matrix element.
+ */
+static double
+spamm_chunk_check_square (const unsigned int offset,
+    const spamm_chunk_t *const chunk)
+{
+  double Aij = spamm_chunk_get_matrix_element(offset, chunk);
+
+  if(*spamm_chunk_get_precision(chunk) == single_precision)
+  {
+    return (float) (Aij*Aij);
+  }
+
+  return Aij*Aij;
+}
+
 /** Check the consistency of a chunk.
  *
  * @param chunk The chunk.
@@ -26,8 +49,10 @@ spamm_chunk_check (spamm_chunk_t *chunk,
   spamm_norm_t *norm;
   spamm_norm_t *norm2;
 
-  float *matrix;
+#ifdef SPAMM_USE_DILATED_MATRIX
+  double Aij;
   float *matrix_dilated;
+#endif
 
   unsigned int i, j, k;
   unsigned int tier;
@@ -47,25 +72,28 @@ spamm_chunk_check (spamm_chunk_t *chunk,
   number_tiers = *spamm_chunk_get_number_tiers(chunk);
   number_dimensions = *spamm_chunk_get_number_dimensions(chunk);
 
-  matrix = spamm_chunk_get_matrix(chunk);
-
   if(use_linear_tree)
   {
-    /* Check dilated matrix against matrix. */
+#ifdef SPAMM_USE_DILATED_MATRIX
+    /* Check dilated matrix against matrix. Double precision chunks have
+     * none. */
     matrix_dilated = spamm_chunk_get_matrix_dilated(chunk);
 
-    for(i = 0; i < ipow(N_contiguous, number_dimensions); i++)
+    for(i = 0; matrix_dilated != NULL && i < ipow(N_contiguous, number_dimensions); i++)
     {
+      Aij = spamm_chunk_get_matrix_element(i, chunk);
+
       for(j = 0; j < 4; j++)
       {
-        if(matrix[i] != 0 && fabs((matrix[i]-matrix_dilated[4*i+j])/matrix[i]) > rel_tolerance)
+        if(Aij != 0 && fabs((Aij-matrix_dilated[4*i+j])/Aij) > rel_tolerance)
         {
           SPAMM_WARN("chunk: matrix (%e) and matrix_dilated (%e) mismatch, i = %i, j = %i\n",
-              matrix[i], matrix_dilated[4*i+j], i, j);
+              Aij, matrix_dilated[4*i+j], i, j);
           result |= SPAMM_ERROR;
         }
       }
     }
+#endif
 
     /* Check norms. */
     for(tier = 0; tier < number_tiers-SPAMM_KERNEL_DEPTH; tier++)
@@ -78,7 +106,7 @@ spamm_chunk_check (spamm_chunk_t *chunk,
         for(i = linear_index*ipow(N_contiguous >> tier, 2), *norm2_reference = 0;
             i < (linear_index+1)*ipow(N_contiguous >> tier, 2); i++)
         {
-          *norm2_reference += matrix[i]*matrix[i];
+          *norm2_reference += spamm_chunk_check_square(i, chunk);
         }
 
         if(*norm2_reference > 0
@@ -122,7 +150,7 @@ spamm_chunk_check (spamm_chunk_t *chunk,
             + (i*SPAMM_N_KERNEL_BLOCKED+j)*SPAMM_N_BLOCK*SPAMM_N_BLOCK;
           for(k = 0; k < SPAMM_N_BLOCK*SPAMM_N_BLOCK; k++)
           {
-            *norm2_reference += matrix[offset+k]*matrix[offset+k];
+            *norm2_reference += spamm_chunk_check_square(offset+k, chunk);
           }
 
           if(*norm2_reference > 0 && fabs(*norm2_reference - norm2[linear_index])/(*norm2_reference) > rel_tolerance)
@@ -150,7 +178,7 @@ spamm_chunk_check (spamm_chunk_t *chunk,
 
   for(i = 0, *norm2_reference = 0; i < ipow(N_contiguous, number_dimensions); i++)
   {
-    *norm2_reference += matrix[i]*matrix[i];
+    *norm2_reference += spamm_chunk_check_square(i, chunk);
   }
 
   if(*norm2_reference > 0
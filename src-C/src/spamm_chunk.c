@@ -2,6 +2,7 @@
 
 #include "config.h"
 #include "spamm.h"
+#include "spamm_types_private.h"
 
 #include <assert.h>
 #include <math.h>
@@ -97,6 +98,18 @@ spamm_chunk_get_use_linear_tree (const spamm_chunk_t *const chunk)
   return (unsigned int*) ((intptr_t) chunk + 2*sizeof(unsigned int));
 }
 
+/** Get the precision of the matrix elements, see enum spamm_precision_t.
+ *
+ * @param chunk The chunk.
+ *
+ * @return The precision.
+ */
+unsigned int *
+spamm_chunk_get_precision (const spamm_chunk_t *const chunk)
+{
+  return (unsigned int*) ((intptr_t) chunk + 3*sizeof(unsigned int));
+}
+
 /** Get the address of the N array.
  *
  * @param chunk The chunk.
@@ -167,17 +180,57 @@ spamm_chunk_get_matrix (const spamm_chunk_t *const chunk)
   return (float*) ((intptr_t) chunk + (intptr_t) chunk_pointer[3]);
 }
 
+/** Get the address of matrix block of a double precision chunk.
+ *
+ * @param chunk The chunk.
+ *
+ * @return The address of the matrix.
+ */
+double *
+spamm_chunk_get_matrix_double (const spamm_chunk_t *const chunk)
+{
+  void **chunk_pointer = (void*) ((intptr_t) chunk + 4*sizeof(unsigned int));
+  return (double*) ((intptr_t) chunk + (intptr_t) chunk_pointer[3]);
+}
+
+/** Get a matrix element of a chunk, in either precision.
+ *
+ * @param offset The linear offset of the element in the chunk matrix, see
+ * spamm_chunk_matrix_index().
+ * @param chunk The chunk.
+ *
+ * @return The matrix element.
+ */
+double
+spamm_chunk_get_matrix_element (const unsigned int offset,
+    const spamm_chunk_t *const chunk)
+{
+  if(*spamm_chunk_get_precision(chunk) == double_precision)
+  {
+    return spamm_chunk_get_matrix_double(chunk)[offset];
+  }
+
+  return spamm_chunk_get_matrix(chunk)[offset];
+}
+
 /** Get the address of dilated matrix block.
  *
  * @param chunk The chunk.
  *
- * @return The address of the dilated matrix.
+ * @return The address of the dilated matrix, or NULL if the chunk is stored
+ * without it.
  */
 float *
 spamm_chunk_get_matrix_dilated (const spamm_chunk_t *const chunk)
 {
+#ifdef SPAMM_USE_DILATED_MATRIX
   void **chunk_pointer = (void*) ((intptr_t) chunk + 4*sizeof(unsigned int));
+
+  if(chunk_pointer[4] == NULL) { return NULL; }
   return (float*) ((intptr_t) chunk + (intptr_t) chunk_pointer[4]);
+#else
+  return NULL;
+#endif
 }
 
 /** Get the total number of norm entries across all tiers stored in the SpAMM
@@ -291,6 +344,117 @@ spamm_chunk_get_tier_norm2 (const unsigned int tier,
   return &norm2[offset];
 }
 
+/** Get a pointer to the kernel block indices of a chunk, sorted for use of the
+ * chunk as the left factor (A) of a product. The indices are grouped by
+ * kernel block column, i.e. by the k index of the product, and sorted by
+ * descending norm within each group.
+ *
+ * @param chunk The chunk.
+ *
+ * @return The pointer to the sorted indices, or NULL if the chunk is not a
+ * 2-dimensional linear chunk.
+ */
+unsigned int *
+spamm_chunk_get_sorted_index_A (const spamm_chunk_t *const chunk)
+{
+  void **chunk_pointer = (void*) ((intptr_t) chunk + 4*sizeof(unsigned int));
+
+  if(chunk_pointer[7] == NULL) { return NULL; }
+  return (unsigned int*) ((intptr_t) chunk + (intptr_t) chunk_pointer[7]);
+}
+
+/** Get a pointer to the kernel block indices of a chunk, sorted for use of the
+ * chunk as the right factor (B) of a product. The indices are grouped by
+ * kernel block row, i.e. by the k index of the product, and sorted by
+ * descending norm within each group.
+ *
+ * @param chunk The chunk.
+ *
+ * @return The pointer to the sorted indices, or NULL if the chunk is not a
+ * 2-dimensional linear chunk.
+ */
+unsigned int *
+spamm_chunk_get_sorted_index_B (const spamm_chunk_t *const chunk)
+{
+  void **chunk_pointer = (void*) ((intptr_t) chunk + 4*sizeof(unsigned int));
+
+  if(chunk_pointer[8] == NULL) { return NULL; }
+  return (unsigned int*) ((intptr_t) chunk + (intptr_t) chunk_pointer[8]);
+}
+
+/** Sort the kernel block indices of a 2-dimensional linear chunk by the
+ * norms at the kernel tier. See spamm_chunk_get_sorted_index_A() and
+ * spamm_chunk_get_sorted_index_B(). The chunk norms have to be up to date.
+ *
+ * @param chunk The chunk.
+ */
+void
+spamm_chunk_sort_index (spamm_chunk_t *const chunk)
+{
+  unsigned int *index_A;
+  unsigned int *index_B;
+  unsigned int index_length;
+  unsigned int i;
+
+  spamm_norm_t *norm;
+
+  if((index_A = spamm_chunk_get_sorted_index_A(chunk)) == NULL) { return; }
+  index_B = spamm_chunk_get_sorted_index_B(chunk);
+
+  index_length = spamm_chunk_get_N_contiguous(chunk)/SPAMM_N_KERNEL;
+
+  for(i = 0; i < ipow(index_length, 2); i++)
+  {
+    index_A[i] = i;
+    index_B[i] = i;
+  }
+
+  /* Sort indices along k index. */
+  spamm_sort_masked(ipow(index_length, 2), index_A, MASK_2D_J);
+  spamm_sort_masked(ipow(index_length, 2), index_B, MASK_2D_I);
+
+  /* Sort within each k-block by descending norm. */
+  norm = spamm_chunk_get_tier_norm(*spamm_chunk_get_number_tiers(chunk)-SPAMM_KERNEL_DEPTH-1, chunk);
+
+  for(i = 0; i < index_length; i++)
+  {
+    spamm_sort_norm(index_length, &index_A[i*index_length], norm);
+    spamm_sort_norm(index_length, &index_B[i*index_length], norm);
+  }
+}
+
+/** Re-sort the groups of the sorted kernel block indices which contain one
+ * kernel block, after the norm of that block changed.
+ *
+ * @param index The linear (Z-curve) index of the kernel block.
+ * @param chunk The chunk.
+ */
+void
+spamm_chunk_sort_index_block (const unsigned int index,
+    spamm_chunk_t *const chunk)
+{
+  unsigned int *index_A;
+  unsigned int *index_B;
+  unsigned int index_length;
+  unsigned int i;
+
+  spamm_norm_t *norm;
+
+  if((index_A = spamm_chunk_get_sorted_index_A(chunk)) == NULL) { return; }
+  index_B = spamm_chunk_get_sorted_index_B(chunk);
+
+  index_length = spamm_chunk_get_N_contiguous(chunk)/SPAMM_N_KERNEL;
+  norm = spamm_chunk_get_tier_norm(*spamm_chunk_get_number_tiers(chunk)-SPAMM_KERNEL_DEPTH-1, chunk);
+
+  for(i = 0; index_A[i] != index; i++) {}
+  i -= i%index_length;
+  spamm_sort_norm(index_length, &index_A[i], norm);
+
+  for(i = 0; index_B[i] != index; i++) {}
+  i -= i%index_length;
+  spamm_sort_norm(index_length, &index_B[i], norm);
+}
+
 /** Calculate a linear offset into a SpAMM chunk matrix.
  *
  * When using a linear tree, the matrix data is stored in a hierarchy of
@@ -322,14 +486,11 @@ spamm_chunk_matrix_index (const unsigned int number_dimensions,
 {
   unsigned int offset;
   unsigned int block_offset;
-  unsigned int *i_mapped;
-  unsigned int *i_remainder;
+  unsigned int i_mapped[SPAMM_MAX_NUMBER_DIMENSIONS];
+  unsigned int i_remainder[SPAMM_MAX_NUMBER_DIMENSIONS];
 
   int dim;
 
-  i_mapped = calloc(number_dimensions, sizeof(unsigned int));
-  i_remainder = calloc(number_dimensions, sizeof(unsigned int));
-
   if(use_linear_tree)
   {
 #ifdef INDEX_DEBUG
@@ -376,9 +537,6 @@ spamm_chunk_matrix_index (const unsigned int number_dimensions,
     offset = spamm_index_column_major_2(number_dimensions, N_upper[0]-N_lower[0], i_mapped);
   }
 
-  free(i_mapped);
-  free(i_remainder);
-
   return offset;
 }
 
@@ -403,7 +561,9 @@ spamm_chunk_norm_index (const unsigned int tier,
   unsigned int N_block;
   unsigned int number_dimensions;
   unsigned int number_tiers;
-  unsigned int *i_temp;
+  unsigned int kernel_tier;
+  unsigned int i_temp[SPAMM_MAX_NUMBER_DIMENSIONS];
+  unsigned int i_kernel[SPAMM_MAX_NUMBER_DIMENSIONS];
   unsigned int *N_lower;
 
   assert(chunk != NULL);
@@ -426,8 +586,6 @@ spamm_chunk_norm_index (const unsigned int tier,
   /* Calculate submatrix size at tier. */
   N_block = N_contiguous/(1 << tier);
 
-  i_temp = calloc(number_dimensions, sizeof(unsigned int));
-
   for(dim = 0; dim < number_dimensions; dim++)
   {
     i_temp[dim] = (i[dim]-N_lower[dim])/N_block;
@@ -438,6 +596,21 @@ spamm_chunk_norm_index (const unsigned int tier,
     offset = spamm_index_linear(number_dimensions, i_temp);
   }
 
+  else if(number_tiers > SPAMM_KERNEL_DEPTH)
+  {
+    /* Below the kernel tier, the norms of each kernel block are stored
+     * contiguously, in the Z-curve order of the kernel blocks, and row-major
+     * ordered within, as in spamm_chunk_fix(). */
+    kernel_tier = number_tiers-SPAMM_KERNEL_DEPTH-1;
+    for(dim = 0; dim < number_dimensions; dim++)
+    {
+      i_kernel[dim] = (i[dim]-N_lower[dim])/SPAMM_N_KERNEL;
+      i_temp[dim] = ((i[dim]-N_lower[dim])%SPAMM_N_KERNEL)/N_block;
+    }
+    offset = spamm_index_linear(number_dimensions, i_kernel)*ipow(1 << (tier-kernel_tier), number_dimensions)
+      +spamm_index_row_major_2(number_dimensions, 1 << (tier-kernel_tier), i_temp);
+  }
+
   else
   {
     for(dim = 0; dim < number_dimensions; dim++)
@@ -447,8 +620,6 @@ spamm_chunk_norm_index (const unsigned int tier,
     offset = spamm_index_row_major_2(number_dimensions, 1 << tier, i_temp);
   }
 
-  free(i_temp);
-
   return offset;
 }
 
@@ -459,6 +630,7 @@ spamm_chunk_norm_index (const unsigned int tier,
  *
  * @param number_dimensions [in] The number of dimensions.
  * @param use_linear_tree [in] Whether to use the linear tree code or not.
+ * @param precision [in] The precision of the matrix elements.
  * @param number_tiers [out] The number of tiers stored in this chunk. If
  * use_linear_tree then the chunk matrix size is >= SPAMM_N_KERNEL, and the
  * number of tiers is down to SPAMM_N_BLOCK.
@@ -471,22 +643,27 @@ spamm_chunk_norm_index (const unsigned int tier,
  * @param A_dilated_pointer [out] Pointer to A_dilated.
  * @param norm_pointer [out] Pointer to norm[].
  * @param norm2_pointer [out] Pointer to norm2[].
+ * @param index_A_pointer [out] Pointer to index_A[].
+ * @param index_B_pointer [out] Pointer to index_B[].
  *
  * @return The size in bytes of the chunk.
  */
 size_t
 spamm_chunk_get_size_for_allocation (const unsigned int number_dimensions,
     const short use_linear_tree,
+    const enum spamm_precision_t precision,
     unsigned int *number_tiers,
     const unsigned int *const N_lower,
     const unsigned int *const N_upper,
     unsigned int **N_pointer,
     unsigned int **N_lower_pointer,
     unsigned int **N_upper_pointer,
-    float **A_pointer,
+    void **A_pointer,
     float **A_dilated_pointer,
     spamm_norm_t **norm_pointer,
-    spamm_norm_t **norm2_pointer)
+    spamm_norm_t **norm2_pointer,
+    unsigned int **index_A_pointer,
+    unsigned int **index_B_pointer)
 {
   unsigned int N_contiguous;
   int dim;
@@ -494,6 +671,9 @@ spamm_chunk_get_size_for_allocation (const unsigned int number_dimensions,
   double tier_temp;
 
   size_t size = 0;
+  size_t element_size;
+
+  element_size = (precision == double_precision ? sizeof(double) : sizeof(float));
 
   /* Calculate sizes needed. */
   for(dim = 0, N_contiguous = 0; dim < number_dimensions; dim++)
@@ -549,15 +729,17 @@ spamm_chunk_get_size_for_allocation (const unsigned int number_dimensions,
   size += sizeof(unsigned int);  /* number_dimensions */
   size += sizeof(unsigned int);  /* number_tiers */
   size += sizeof(unsigned int);  /* use_linear_tree */
-  size += sizeof(unsigned int);  /* Padding. */
+  size += sizeof(unsigned int);  /* precision */
 
   size += sizeof(unsigned int*); /* N_pointer */
   size += sizeof(unsigned int*); /* N_lower_pointer */
   size += sizeof(unsigned int*); /* N_upper_pointer */
-  size += sizeof(float*);        /* A_pointer */
+  size += sizeof(void*);         /* A_pointer */
   size += sizeof(float*);        /* A_dilated_pointer */
   size += sizeof(spamm_norm_t*); /* norm_pointer */
   size += sizeof(spamm_norm_t*); /* norm2_pointer */
+  size += sizeof(unsigned int*); /* index_A_pointer */
+  size += sizeof(unsigned int*); /* index_B_pointer */
 
   /* Fields. */
   *N_pointer       = (unsigned int*) size; size += number_dimensions*sizeof(unsigned int); /* N[number_dimensions] */
@@ -568,13 +750,27 @@ spamm_chunk_get_size_for_allocation (const unsigned int number_dimensions,
   size = spamm_chunk_pad(size, SPAMM_ALIGNMENT);
 
   /* Matrix data. */
-  *A_pointer = (float*) size; size += ipow(N_contiguous, number_dimensions)*sizeof(float); /* A[ipow(N_contiguous, number_dimensions)] */
+  *A_pointer = (void*) size; size += ipow(N_contiguous, number_dimensions)*element_size; /* A[ipow(N_contiguous, number_dimensions)] */
 
   /* Pad. */
   size = spamm_chunk_pad(size, SPAMM_ALIGNMENT);
 
-  /* Dilated matrix data. */
-  *A_dilated_pointer = (float*) size; size += 4*ipow(N_contiguous, number_dimensions)*sizeof(float); /* A_dilated[4*N_contiguous, number_dimensions)] */
+  /* Dilated matrix data. Only the SSE assembly kernel needs it, kernels
+   * with broadcast loads read A directly, and it never runs on double
+   * precision chunks. */
+#ifdef SPAMM_USE_DILATED_MATRIX
+  if(precision == single_precision)
+  {
+    *A_dilated_pointer = (float*) size; size += 4*ipow(N_contiguous, number_dimensions)*sizeof(float); /* A_dilated[4*N_contiguous, number_dimensions)] */
+  }
+
+  else
+  {
+    *A_dilated_pointer = NULL;
+  }
+#else
+  *A_dilated_pointer = NULL;
+#endif
 
   /* Norm. */
   *norm_pointer = (spamm_norm_t*) size;
@@ -588,6 +784,19 @@ spamm_chunk_get_size_for_allocation (const unsigned int number_dimensions,
   /* Add up all tiers. */
   size += spamm_chunk_get_total_number_norms(*number_tiers, number_dimensions)*sizeof(spamm_norm_t);
 
+  /* The kernel block indices sorted by norm, for the linear multiply. */
+  if(use_linear_tree && number_dimensions == 2)
+  {
+    *index_A_pointer = (unsigned int*) size; size += ipow(N_contiguous/SPAMM_N_KERNEL, 2)*sizeof(unsigned int); /* index_A[ipow(N_contiguous/SPAMM_N_KERNEL, 2)] */
+    *index_B_pointer = (unsigned int*) size; size += ipow(N_contiguous/SPAMM_N_KERNEL, 2)*sizeof(unsigned int); /* index_B[ipow(N_contiguous/SPAMM_N_KERNEL, 2)] */
+  }
+
+  else
+  {
+    *index_A_pointer = NULL;
+    *index_B_pointer = NULL;
+  }
+
   return size;
 }
 
@@ -608,22 +817,27 @@ spamm_chunk_get_size (spamm_chunk_t *const chunk)
   unsigned int *N_lower = spamm_chunk_get_N_lower(chunk);
   unsigned int *N_upper = spamm_chunk_get_N_upper(chunk);
 
+  enum spamm_precision_t precision = *spamm_chunk_get_precision(chunk);
+
   unsigned int number_tiers;
   unsigned int *N_pointer;
   unsigned int *N_lower_pointer;
   unsigned int *N_upper_pointer;
-  float *A_pointer;
+  void *A_pointer;
   float *A_dilated_pointer;
   spamm_norm_t *norm_pointer;
   spamm_norm_t *norm2_pointer;
+  unsigned int *index_A_pointer;
+  unsigned int *index_B_pointer;
 
   return spamm_chunk_get_size_for_allocation(number_dimensions,
-      use_linear_tree, &number_tiers, N_lower, N_upper, &N_pointer,
+      use_linear_tree, precision, &number_tiers, N_lower, N_upper, &N_pointer,
       &N_lower_pointer, &N_upper_pointer, &A_pointer, &A_dilated_pointer,
-      &norm_pointer, &norm2_pointer);
+      &norm_pointer, &norm2_pointer, &index_A_pointer, &index_B_pointer);
 }
 
-/** Set the norms and the dilated matrix in a chunk.
+/** Set the norms, the dilated matrix, and the sorted kernel block indices in
+ * a chunk.
  *
  * @param chunk The chunk.
  * @param flop The flop count.
@@ -636,178 +850,12 @@ spamm_chunk_fix (spamm_chunk_t *const chunk,
     double *const flop,
     double *const mop)
 {
-  float *matrix;
-  float *matrix_dilated;
-
-  spamm_norm_t *norm;
-  spamm_norm_t *next_norm;
-  spamm_norm_t *norm2;
-  spamm_norm_t *next_norm2;
-
-  short terminate;
-
-  unsigned int N_contiguous;
-  unsigned int number_dimensions;
-  unsigned int use_linear_tree;
-  unsigned int number_tiers;
-
-  int tier;
-
-  unsigned int dim;
-  unsigned int i_stream;
-  unsigned int *i;
-  unsigned int i_block, j_block;
-  unsigned int norm_offset;
-  unsigned int matrix_offset;
-  unsigned int block_offset;
-
   assert(chunk != NULL);
 
-  N_contiguous = spamm_chunk_get_N_contiguous(chunk);
-  use_linear_tree = *spamm_chunk_get_use_linear_tree(chunk);
-  number_tiers = *spamm_chunk_get_number_tiers(chunk);
-
-  matrix = spamm_chunk_get_matrix(chunk);
-  matrix_dilated = spamm_chunk_get_matrix_dilated(chunk);
-
-  /* Norms at deepest tier. */
-  norm = spamm_chunk_get_tier_norm(number_tiers-1, chunk);
-  norm2 = spamm_chunk_get_tier_norm2(number_tiers-1, chunk);
-
-  if(use_linear_tree)
+  if(*spamm_chunk_get_precision(chunk) == double_precision)
   {
-    /* Norms at kernel tier. */
-    if(number_tiers > SPAMM_KERNEL_DEPTH)
-    {
-      next_norm = spamm_chunk_get_tier_norm(number_tiers-SPAMM_KERNEL_DEPTH-1, chunk);
-      next_norm2 = spamm_chunk_get_tier_norm2(number_tiers-SPAMM_KERNEL_DEPTH-1, chunk);
-    }
-
-    /* Linear trees are only used in 2 dimensions. */
-    i = calloc(2, sizeof(unsigned int));
-
-    /* Fix norms on lowest tier, and update matrix_dilated. */
-    for(i_stream = 0; i_stream < ipow(N_contiguous/SPAMM_N_KERNEL, 2); i_stream++)
-    {
-      if(number_tiers > SPAMM_KERNEL_DEPTH)
-      {
-        next_norm2[i_stream] = 0.0;
-      }
-
-      /* We are at the SPAMM_N_KERNEL tier. The submatrix blocks are Z-curve
-       * ordered. Below this tier we store row-major ordered submatrices of
-       * size SPAMM_N_BLOCK.
-       */
-      for(i[0] = 0; i[0] < SPAMM_N_KERNEL_BLOCKED; i[0]++) {
-        for(i[1] = 0; i[1] < SPAMM_N_KERNEL_BLOCKED; i[1]++)
-        {
-          norm_offset = i_stream*SPAMM_N_KERNEL_BLOCKED*SPAMM_N_KERNEL_BLOCKED /* Z-curve ordered offset. */
-            +i[0]*SPAMM_N_KERNEL_BLOCKED+i[1]; /* Row-major ordered offset. */
-
-          matrix_offset = i_stream*SPAMM_N_KERNEL*SPAMM_N_KERNEL /* Z-curve ordered offset. */
-            +(i[0]*SPAMM_N_KERNEL_BLOCKED+i[1])*SPAMM_N_BLOCK*SPAMM_N_BLOCK; /* Row-major ordered offset. */
-
-          /* Loop over matrix elements within the submatrices of size SPAMM_N_BLOCK. */
-          norm2[norm_offset] = 0.0;
-          for(i_block = 0; i_block < SPAMM_N_BLOCK; i_block++) {
-            for(j_block = 0; j_block < SPAMM_N_BLOCK; j_block++)
-            {
-              block_offset = i_block*SPAMM_N_BLOCK+j_block; /* Row-major order of matrix elements. */
-
-              /* Fix norm. */
-              norm2[norm_offset] += matrix[matrix_offset+block_offset]*matrix[matrix_offset+block_offset];
-
-              /* Fix dilated matrix. */
-              matrix_dilated[4*(matrix_offset+block_offset)+0] = matrix[matrix_offset+block_offset];
-              matrix_dilated[4*(matrix_offset+block_offset)+1] = matrix[matrix_offset+block_offset];
-              matrix_dilated[4*(matrix_offset+block_offset)+2] = matrix[matrix_offset+block_offset];
-              matrix_dilated[4*(matrix_offset+block_offset)+3] = matrix[matrix_offset+block_offset];
-            }
-          }
-          norm[norm_offset] = sqrt(norm2[norm_offset]);
-
-          /* Fix norms at kernel tier. */
-          if(number_tiers > SPAMM_KERNEL_DEPTH)
-          {
-            next_norm2[i_stream] += norm2[norm_offset];
-          }
-        }
-      }
-      if(number_tiers > SPAMM_KERNEL_DEPTH)
-      {
-        next_norm[i_stream] = sqrt(next_norm2[i_stream]);
-      }
-    }
-
-    /* Update mop count. */
-    *mop += ipow(N_contiguous/SPAMM_N_KERNEL, 2)*SPAMM_N_BLOCK*SPAMM_N_BLOCK;
-
-    /* Update norms up to the root tier of this chunk. */
-    for(tier = number_tiers-SPAMM_KERNEL_DEPTH-2; tier >= 0; tier--)
-    {
-      norm2 = spamm_chunk_get_tier_norm2(tier+1, chunk);
-
-      next_norm = spamm_chunk_get_tier_norm(tier, chunk);
-      next_norm2 = spamm_chunk_get_tier_norm2(tier, chunk);
-
-      for(i[0] = 0; i[0] < ipow(4, tier); i[0]++)
-      {
-        for(i[1] = 4*i[0], next_norm2[i[0]] = 0; i[1] < 4*(i[0]+1); i[1]++)
-        {
-          next_norm2[i[0]] += norm2[i[1]];
-        }
-        next_norm[i[0]] = sqrt(next_norm2[i[0]]);
-      }
-    }
-
-    free(i);
-
-    return next_norm2[0];
+    return spamm_chunk_fix_double(chunk, flop, mop);
   }
 
-  else
-  {
-    /* Allocate matrix index. */
-    number_dimensions = *spamm_chunk_get_number_dimensions(chunk);
-    i = calloc(number_dimensions, sizeof(unsigned int));
-
-    for(norm2[0] = 0.0, terminate = 0; !terminate; )
-    {
-      matrix_offset = spamm_index_column_major_2(number_dimensions, N_contiguous, i);
-
-      /* Update norm. */
-      norm2[0] += matrix[matrix_offset]*matrix[matrix_offset];
-
-      /* Update dilated matrix. */
-      matrix_dilated[4*matrix_offset+0] = matrix[matrix_offset];
-      matrix_dilated[4*matrix_offset+1] = matrix[matrix_offset];
-      matrix_dilated[4*matrix_offset+2] = matrix[matrix_offset];
-      matrix_dilated[4*matrix_offset+3] = matrix[matrix_offset];
-
-      /* Increment matrix index. */
-      for(dim = 0; dim < number_dimensions; dim++)
-      {
-        i[dim]++;
-        if(i[dim] >= N_contiguous)
-        {
-          if(dim >= number_dimensions-1)
-          {
-            terminate = 1;
-            break;
-          }
-          i[dim] = 0;
-        }
-
-        else
-        {
-          break;
-        }
-      }
-    }
-    norm[0] = sqrt(norm2[0]);
-
-    free(i);
-
-    return norm2[0];
-  }
+  return spamm_chunk_fix_float(chunk, flop, mop);
 }
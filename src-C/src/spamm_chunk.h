@@ -18,14 +18,14 @@
 __BEGIN_DECLARATIONS
 
 spamm_norm_t
-spamm_chunk_multiply_scalar (const float alpha,
+spamm_chunk_multiply_scalar (const double alpha,
     spamm_chunk_t *chunk,
     double *const flop,
     double *const memop);
 
 spamm_norm_t
 spamm_chunk_multiply (const spamm_norm_t tolerance,
-    const float alpha,
+    const double alpha,
     const spamm_chunk_t *const chunk_A,
     const spamm_chunk_t *const chunk_B,
     spamm_chunk_t *const chunk_C,
@@ -49,6 +49,9 @@ spamm_chunk_get_number_tiers (const spamm_chunk_t *const chunk);
 unsigned int *
 spamm_chunk_get_use_linear_tree (const spamm_chunk_t *const chunk);
 
+unsigned int *
+spamm_chunk_get_precision (const spamm_chunk_t *const chunk);
+
 unsigned int *
 spamm_chunk_get_N (const spamm_chunk_t *const chunk);
 
@@ -64,6 +67,13 @@ spamm_chunk_get_N_contiguous (const spamm_chunk_t *const chunk);
 float *
 spamm_chunk_get_matrix (const spamm_chunk_t *const chunk);
 
+double *
+spamm_chunk_get_matrix_double (const spamm_chunk_t *const chunk);
+
+double
+spamm_chunk_get_matrix_element (const unsigned int offset,
+    const spamm_chunk_t *const chunk);
+
 float *
 spamm_chunk_get_matrix_dilated (const spamm_chunk_t *const chunk);
 
@@ -84,6 +94,19 @@ spamm_norm_t *
 spamm_chunk_get_tier_norm2 (const unsigned int tier,
     const spamm_chunk_t *const chunk);
 
+unsigned int *
+spamm_chunk_get_sorted_index_A (const spamm_chunk_t *const chunk);
+
+unsigned int *
+spamm_chunk_get_sorted_index_B (const spamm_chunk_t *const chunk);
+
+void
+spamm_chunk_sort_index (spamm_chunk_t *const chunk);
+
+void
+spamm_chunk_sort_index_block (const unsigned int index,
+    spamm_chunk_t *const chunk);
+
 unsigned int
 spamm_chunk_matrix_index (const unsigned int number_dimensions,
     const short use_linear_tree,
@@ -99,16 +122,19 @@ spamm_chunk_norm_index (const unsigned int tier,
 size_t
 spamm_chunk_get_size_for_allocation (const unsigned int number_dimensions,
     const short use_linear_tree,
+    const enum spamm_precision_t precision,
     unsigned int *number_tiers,
     const unsigned int *const N_lower,
     const unsigned int *const N_upper,
     unsigned int **N_pointer,
     unsigned int **N_lower_pointer,
     unsigned int **N_upper_pointer,
-    float **A_pointer,
+    void **A_pointer,
     float **A_dilated_pointer,
     spamm_norm_t **norm_pointer,
-    spamm_norm_t **norm2_pointer);
+    spamm_norm_t **norm2_pointer,
+    unsigned int **index_A_pointer,
+    unsigned int **index_B_pointer);
 
 size_t
 spamm_chunk_get_size (spamm_chunk_t *const chunk);
@@ -118,11 +144,89 @@ spamm_chunk_fix (spamm_chunk_t *const chunk,
     double *const flop,
     double *const memop);
 
-void
+double
 spamm_chunk_set (const unsigned int *const i,
-    const float Aij,
+    const double Aij,
     spamm_chunk_t *chunk);
 
+spamm_norm_t
+spamm_chunk_fix_float (spamm_chunk_t *const chunk,
+    double *const flop,
+    double *const memop);
+
+spamm_norm_t
+spamm_chunk_multiply_scalar_float (const float alpha,
+    spamm_chunk_t *chunk,
+    double *const flop,
+    double *const memop);
+
+spamm_norm_t
+spamm_chunk_add_float (const float alpha,
+    spamm_chunk_t *A,
+    const float beta,
+    spamm_chunk_t *B,
+    double *const flop,
+    double *const memop);
+
+void
+spamm_chunk_copy_matrix_float (spamm_chunk_t *A,
+    const float beta,
+    spamm_chunk_t *B,
+    double *const flop,
+    double *const memop);
+
+spamm_norm_t
+spamm_chunk_multiply_float (const spamm_norm_t tolerance,
+    const float alpha,
+    const spamm_chunk_t *const chunk_A,
+    const spamm_chunk_t *const chunk_B,
+    spamm_chunk_t *const chunk_C,
+    sgemm_func sgemm,
+    double *const flop,
+    double *const memop);
+
+unsigned int
+spamm_chunk_number_nonzero_float (const spamm_chunk_t *const chunk);
+
+spamm_norm_t
+spamm_chunk_fix_double (spamm_chunk_t *const chunk,
+    double *const flop,
+    double *const memop);
+
+spamm_norm_t
+spamm_chunk_multiply_scalar_double (const double alpha,
+    spamm_chunk_t *chunk,
+    double *const flop,
+    double *const memop);
+
+spamm_norm_t
+spamm_chunk_add_double (const double alpha,
+    spamm_chunk_t *A,
+    const double beta,
+    spamm_chunk_t *B,
+    double *const flop,
+    double *const memop);
+
+void
+spamm_chunk_copy_matrix_double (spamm_chunk_t *A,
+    const double beta,
+    spamm_chunk_t *B,
+    double *const flop,
+    double *const memop);
+
+spamm_norm_t
+spamm_chunk_multiply_double (const spamm_norm_t tolerance,
+    const double alpha,
+    const spamm_chunk_t *const chunk_A,
+    const spamm_chunk_t *const chunk_B,
+    spamm_chunk_t *const chunk_C,
+    sgemm_func sgemm,
+    double *const flop,
+    double *const memop);
+
+unsigned int
+spamm_chunk_number_nonzero_double (const spamm_chunk_t *const chunk);
+
 __END_DECLARATIONS
 
 #endif
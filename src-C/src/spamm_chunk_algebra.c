@@ -0,0 +1,20 @@
+/** @file spamm_chunk_algebra.c
+ *
+ * The algebra on chunks, in single and double precision. The functions are
+ * generated from spamm_chunk_algebra_source.c for each element type, and
+ * carry the type as a suffix, e.g. spamm_chunk_fix_float() and
+ * spamm_chunk_fix_double(). The generic functions, e.g. spamm_chunk_fix(),
+ * dispatch on the precision of the chunk.
+ */
+
+#include "typed_function.h"
+
+#define SPAMM_TYPE float
+#define SPAMM_TYPE_SINGLE
+#include "spamm_chunk_algebra_source.c"
+#undef SPAMM_TYPE_SINGLE
+#undef SPAMM_TYPE
+
+#define SPAMM_TYPE double
+#include "spamm_chunk_algebra_source.c"
+#undef SPAMM_TYPE
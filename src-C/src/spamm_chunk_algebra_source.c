@@ -0,0 +1,603 @@
+/** @file
+ *
+ * The chunk algebra for one element type, SPAMM_TYPE. This file is included
+ * by spamm_chunk_algebra.c once for each type. SPAMM_TYPE_SINGLE is defined
+ * for the single precision instance, which also maintains the dilated
+ * matrix, and multiplies with the sgemm() passed in by the caller.
+ */
+
+#include "config.h"
+#include "spamm.h"
+#include "spamm_types_private.h"
+#include "spamm_blas.h"
+
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+#ifdef SPAMM_TYPE_SINGLE
+#define SPAMM_CHUNK_MATRIX(chunk) spamm_chunk_get_matrix(chunk)
+#else
+#define SPAMM_CHUNK_MATRIX(chunk) spamm_chunk_get_matrix_double(chunk)
+#endif
+
+#if defined(SPAMM_TYPE_SINGLE) && defined(SPAMM_USE_DILATED_MATRIX)
+#define SPAMM_CHUNK_DILATED
+#endif
+
+/** Set the norms, the dilated matrix, and the sorted kernel block indices in
+ * a chunk.
+ *
+ * @param chunk The chunk.
+ * @param flop The flop count.
+ * @param mop The memory operation count
+ *
+ * @return The square of the norm of the chunk.
+ */
+spamm_norm_t
+TYPED_FUNCTION(spamm_chunk_fix, SPAMM_TYPE) (spamm_chunk_t *const chunk,
+    double *const flop,
+    double *const mop)
+{
+  SPAMM_TYPE *matrix;
+#ifdef SPAMM_CHUNK_DILATED
+  float *matrix_dilated;
+#endif
+
+  spamm_norm_t *norm;
+  spamm_norm_t *next_norm;
+  spamm_norm_t *norm2;
+  spamm_norm_t *next_norm2;
+
+  short terminate;
+
+  unsigned int N_contiguous;
+  unsigned int number_dimensions;
+  unsigned int use_linear_tree;
+  unsigned int number_tiers;
+
+  int tier;
+
+  unsigned int dim;
+  unsigned int i_stream;
+  unsigned int i[SPAMM_MAX_NUMBER_DIMENSIONS];
+  unsigned int i_block, j_block;
+  unsigned int norm_offset;
+  unsigned int matrix_offset;
+  unsigned int block_offset;
+
+  assert(chunk != NULL);
+
+  N_contiguous = spamm_chunk_get_N_contiguous(chunk);
+  use_linear_tree = *spamm_chunk_get_use_linear_tree(chunk);
+  number_tiers = *spamm_chunk_get_number_tiers(chunk);
+
+  matrix = SPAMM_CHUNK_MATRIX(chunk);
+#ifdef SPAMM_CHUNK_DILATED
+  matrix_dilated = spamm_chunk_get_matrix_dilated(chunk);
+#endif
+
+  /* Norms at deepest tier. */
+  norm = spamm_chunk_get_tier_norm(number_tiers-1, chunk);
+  norm2 = spamm_chunk_get_tier_norm2(number_tiers-1, chunk);
+
+  if(use_linear_tree)
+  {
+    /* Norms at kernel tier. */
+    if(number_tiers > SPAMM_KERNEL_DEPTH)
+    {
+      next_norm = spamm_chunk_get_tier_norm(number_tiers-SPAMM_KERNEL_DEPTH-1, chunk);
+      next_norm2 = spamm_chunk_get_tier_norm2(number_tiers-SPAMM_KERNEL_DEPTH-1, chunk);
+    }
+
+    /* Fix norms on lowest tier, and update matrix_dilated. */
+    for(i_stream = 0; i_stream < ipow(N_contiguous/SPAMM_N_KERNEL, 2); i_stream++)
+    {
+      if(number_tiers > SPAMM_KERNEL_DEPTH)
+      {
+        next_norm2[i_stream] = 0.0;
+      }
+
+      /* We are at the SPAMM_N_KERNEL tier. The submatrix blocks are Z-curve
+       * ordered. Below this tier we store row-major ordered submatrices of
+       * size SPAMM_N_BLOCK.
+       */
+      for(i[0] = 0; i[0] < SPAMM_N_KERNEL_BLOCKED; i[0]++) {
+        for(i[1] = 0; i[1] < SPAMM_N_KERNEL_BLOCKED; i[1]++)
+        {
+          norm_offset = i_stream*SPAMM_N_KERNEL_BLOCKED*SPAMM_N_KERNEL_BLOCKED /* Z-curve ordered offset. */
+            +i[0]*SPAMM_N_KERNEL_BLOCKED+i[1]; /* Row-major ordered offset. */
+
+          matrix_offset = i_stream*SPAMM_N_KERNEL*SPAMM_N_KERNEL /* Z-curve ordered offset. */
+            +(i[0]*SPAMM_N_KERNEL_BLOCKED+i[1])*SPAMM_N_BLOCK*SPAMM_N_BLOCK; /* Row-major ordered offset. */
+
+          /* Loop over matrix elements within the submatrices of size SPAMM_N_BLOCK. */
+          norm2[norm_offset] = 0.0;
+          for(i_block = 0; i_block < SPAMM_N_BLOCK; i_block++) {
+            for(j_block = 0; j_block < SPAMM_N_BLOCK; j_block++)
+            {
+              block_offset = i_block*SPAMM_N_BLOCK+j_block; /* Row-major order of matrix elements. */
+
+              /* Fix norm. */
+              norm2[norm_offset] += matrix[matrix_offset+block_offset]*matrix[matrix_offset+block_offset];
+
+#ifdef SPAMM_CHUNK_DILATED
+              /* Fix dilated matrix. */
+              matrix_dilated[4*(matrix_offset+block_offset)+0] = matrix[matrix_offset+block_offset];
+              matrix_dilated[4*(matrix_offset+block_offset)+1] = matrix[matrix_offset+block_offset];
+              matrix_dilated[4*(matrix_offset+block_offset)+2] = matrix[matrix_offset+block_offset];
+              matrix_dilated[4*(matrix_offset+block_offset)+3] = matrix[matrix_offset+block_offset];
+#endif
+            }
+          }
+          norm[norm_offset] = sqrt(norm2[norm_offset]);
+
+          /* Fix norms at kernel tier. */
+          if(number_tiers > SPAMM_KERNEL_DEPTH)
+          {
+            next_norm2[i_stream] += norm2[norm_offset];
+          }
+        }
+      }
+      if(number_tiers > SPAMM_KERNEL_DEPTH)
+      {
+        next_norm[i_stream] = sqrt(next_norm2[i_stream]);
+      }
+    }
+
+    /* Update mop count. */
+    *mop += ipow(N_contiguous/SPAMM_N_KERNEL, 2)*SPAMM_N_BLOCK*SPAMM_N_BLOCK;
+
+    /* Update norms up to the root tier of this chunk. */
+    for(tier = number_tiers-SPAMM_KERNEL_DEPTH-2; tier >= 0; tier--)
+    {
+      norm2 = spamm_chunk_get_tier_norm2(tier+1, chunk);
+
+      next_norm = spamm_chunk_get_tier_norm(tier, chunk);
+      next_norm2 = spamm_chunk_get_tier_norm2(tier, chunk);
+
+      for(i[0] = 0; i[0] < ipow(4, tier); i[0]++)
+      {
+        for(i[1] = 4*i[0], next_norm2[i[0]] = 0; i[1] < 4*(i[0]+1); i[1]++)
+        {
+          next_norm2[i[0]] += norm2[i[1]];
+        }
+        next_norm[i[0]] = sqrt(next_norm2[i[0]]);
+      }
+    }
+
+    /* Sort the kernel blocks by their new norms. */
+    spamm_chunk_sort_index(chunk);
+
+    return next_norm2[0];
+  }
+
+  else
+  {
+    /* Initialize matrix index. */
+    number_dimensions = *spamm_chunk_get_number_dimensions(chunk);
+    for(dim = 0; dim < number_dimensions; dim++)
+    {
+      i[dim] = 0;
+    }
+
+    for(norm2[0] = 0.0, terminate = 0; !terminate; )
+    {
+      matrix_offset = spamm_index_column_major_2(number_dimensions, N_contiguous, i);
+
+      /* Update norm. */
+      norm2[0] += matrix[matrix_offset]*matrix[matrix_offset];
+
+#ifdef SPAMM_CHUNK_DILATED
+      /* Update dilated matrix. */
+      matrix_dilated[4*matrix_offset+0] = matrix[matrix_offset];
+      matrix_dilated[4*matrix_offset+1] = matrix[matrix_offset];
+      matrix_dilated[4*matrix_offset+2] = matrix[matrix_offset];
+      matrix_dilated[4*matrix_offset+3] = matrix[matrix_offset];
+#endif
+
+      /* Increment matrix index. */
+      for(dim = 0; dim < number_dimensions; dim++)
+      {
+        i[dim]++;
+        if(i[dim] >= N_contiguous)
+        {
+          if(dim >= number_dimensions-1)
+          {
+            terminate = 1;
+            break;
+          }
+          i[dim] = 0;
+        }
+
+        else
+        {
+          break;
+        }
+      }
+    }
+    norm[0] = sqrt(norm2[0]);
+
+    return norm2[0];
+  }
+}
+
+/** Multiply a chunk with a scalar.
+ *
+ * @param alpha The factor.
+ * @param chunk The chunk.
+ * @param flop The flop count.
+ * @param mop The memory operation count.
+ *
+ * @return The new squared norm.
+ */
+spamm_norm_t
+TYPED_FUNCTION(spamm_chunk_multiply_scalar, SPAMM_TYPE) (const SPAMM_TYPE alpha,
+    spamm_chunk_t *chunk,
+    double *const flop,
+    double *const mop)
+{
+  unsigned int i;
+  unsigned int number_norms;
+  unsigned int number_tiers;
+  unsigned int N_contiguous;
+  unsigned int number_dimensions;
+
+  SPAMM_TYPE *A;
+#ifdef SPAMM_CHUNK_DILATED
+  float *A_dilated;
+#endif
+
+  SPAMM_TYPE alpha2;
+
+  assert(flop != NULL);
+  assert(mop != NULL);
+
+  spamm_norm_t *norm;
+  spamm_norm_t *norm2;
+
+  if(chunk == NULL) { return 0.0; }
+
+  number_dimensions = *spamm_chunk_get_number_dimensions(chunk);
+  number_tiers = *spamm_chunk_get_number_tiers(chunk);
+  N_contiguous = spamm_chunk_get_N_contiguous(chunk);
+  A = SPAMM_CHUNK_MATRIX(chunk);
+#ifdef SPAMM_CHUNK_DILATED
+  A_dilated = spamm_chunk_get_matrix_dilated(chunk);
+#endif
+
+  if(alpha == 0.0)
+  {
+    for(i = 0; i < ipow(N_contiguous, number_dimensions); i++)
+    {
+      A[i] = 0.0;
+
+#ifdef SPAMM_CHUNK_DILATED
+      A_dilated[4*i+0] = 0.0;
+      A_dilated[4*i+1] = 0.0;
+      A_dilated[4*i+2] = 0.0;
+      A_dilated[4*i+3] = 0.0;
+#endif
+    }
+  }
+
+  else
+  {
+    if(alpha != 1.0)
+    {
+      for(i = 0; i < ipow(N_contiguous, number_dimensions); i++)
+      {
+        A[i] *= alpha;
+      }
+
+      /* Update the flop count. */
+      *flop += ipow(N_contiguous, number_dimensions);
+      *mop += 2*ipow(N_contiguous, number_dimensions);
+
+      /* Recompute the norms (and the dilated matrix) from the scaled
+       * elements, rather than scaling them, so that they stay consistent
+       * with the matrix to rounding. */
+      return TYPED_FUNCTION(spamm_chunk_fix, SPAMM_TYPE)(chunk, flop, mop);
+    }
+  }
+
+  norm = spamm_chunk_get_norm(chunk);
+  norm2 = spamm_chunk_get_norm2(chunk);
+  number_norms = spamm_chunk_get_total_number_norms(number_tiers, number_dimensions);
+  alpha2 = alpha*alpha;
+  for(i = 0; i < number_norms; i++)
+  {
+    norm2[i] *= alpha2;
+    norm[i] = sqrt(norm2[i]);
+  }
+
+  return norm2[0];
+}
+
+/** Add two SpAMM chunks. @f$ A \leftarrow \alpha A + \beta B @f$.
+ *
+ * @param alpha The factor @f$ \alpha @f$.
+ * @param A Chunk A.
+ * @param beta The factor @f$ \beta @f$.
+ * @param B Chunk B.
+ * @param flop The flop count.
+ * @param mop The memory operation count
+ *
+ * @return The square of the norm of the chunk.
+ */
+spamm_norm_t
+TYPED_FUNCTION(spamm_chunk_add, SPAMM_TYPE) (const SPAMM_TYPE alpha,
+    spamm_chunk_t *A,
+    const SPAMM_TYPE beta,
+    spamm_chunk_t *B,
+    double *const flop,
+    double *const mop)
+{
+  unsigned int number_dimensions;
+
+  SPAMM_TYPE *A_matrix;
+  SPAMM_TYPE *B_matrix;
+
+  unsigned int N_contiguous;
+
+  unsigned int i;
+
+  assert(A != NULL);
+  assert(B != NULL);
+
+  number_dimensions = *spamm_chunk_get_number_dimensions(B);
+
+  A_matrix = SPAMM_CHUNK_MATRIX(A);
+  B_matrix = SPAMM_CHUNK_MATRIX(B);
+
+  N_contiguous = spamm_chunk_get_N_contiguous(A);
+
+  /* Add matrices. */
+  for(i = 0; i < ipow(N_contiguous, number_dimensions); i++)
+  {
+    A_matrix[i] = alpha*A_matrix[i]+beta*B_matrix[i];
+  }
+
+  /* Update flop count. */
+  *flop += ipow(N_contiguous, number_dimensions);
+
+  /* Update norms. */
+  return TYPED_FUNCTION(spamm_chunk_fix, SPAMM_TYPE)(A, flop, mop);
+}
+
+/** Copy the matrix, the norms, and the sorted kernel block indices of a chunk
+ * into a newly allocated chunk of the same shape. \f$ A \leftarrow \beta B
+ * \f$.
+ *
+ * @param A Chunk A.
+ * @param beta The scalar \f$ \beta \f$.
+ * @param B Chunk B.
+ * @param flop The flop count.
+ * @param mop The memory operation count
+ */
+void
+TYPED_FUNCTION(spamm_chunk_copy_matrix, SPAMM_TYPE) (spamm_chunk_t *A,
+    const SPAMM_TYPE beta,
+    spamm_chunk_t *B,
+    double *const flop,
+    double *const mop)
+{
+  unsigned int number_dimensions;
+  unsigned int number_tiers;
+
+  spamm_norm_t *norm_A;
+  spamm_norm_t *norm2_A;
+  spamm_norm_t *norm2_B;
+
+  SPAMM_TYPE *A_matrix;
+  SPAMM_TYPE *B_matrix;
+
+#ifdef SPAMM_CHUNK_DILATED
+  float *A_matrix_dilated;
+#endif
+
+  unsigned int N_contiguous;
+
+  unsigned int i;
+  unsigned int i_norm;
+
+  unsigned int tier;
+
+  number_dimensions = *spamm_chunk_get_number_dimensions(B);
+  number_tiers = *spamm_chunk_get_number_tiers(B);
+
+  norm_A = spamm_chunk_get_norm(A);
+  norm2_A = spamm_chunk_get_norm2(A);
+  norm2_B = spamm_chunk_get_norm2(B);
+
+  N_contiguous = spamm_chunk_get_N_contiguous(B);
+
+  A_matrix = SPAMM_CHUNK_MATRIX(A);
+  B_matrix = SPAMM_CHUNK_MATRIX(B);
+
+#ifdef SPAMM_CHUNK_DILATED
+  A_matrix_dilated = spamm_chunk_get_matrix_dilated(A);
+#endif
+
+  /* Copy matrix elements. */
+  if(beta == 1.0)
+  {
+    for(i = 0; i < ipow(N_contiguous, number_dimensions); i++)
+    {
+      A_matrix[i] = beta*B_matrix[i];
+
+#ifdef SPAMM_CHUNK_DILATED
+      A_matrix_dilated[4*i+0] = A_matrix[i];
+      A_matrix_dilated[4*i+1] = A_matrix[i];
+      A_matrix_dilated[4*i+2] = A_matrix[i];
+      A_matrix_dilated[4*i+3] = A_matrix[i];
+#endif
+    }
+
+    /* Copy norms. */
+    for(tier = 0, i_norm = 0; tier < number_tiers; tier++)
+    {
+      for(i = 0; i < ipow(ipow(2, number_dimensions), tier); i++)
+      {
+        norm2_A[i_norm] = norm2_B[i_norm];
+        norm_A[i_norm] = sqrt(norm2_A[i_norm]);
+        i_norm++;
+      }
+    }
+
+    /* Copy the sorted kernel block indices. */
+    if(spamm_chunk_get_sorted_index_A(B) != NULL)
+    {
+      memcpy(spamm_chunk_get_sorted_index_A(A), spamm_chunk_get_sorted_index_A(B),
+          ipow(N_contiguous/SPAMM_N_KERNEL, 2)*sizeof(unsigned int));
+      memcpy(spamm_chunk_get_sorted_index_B(A), spamm_chunk_get_sorted_index_B(B),
+          ipow(N_contiguous/SPAMM_N_KERNEL, 2)*sizeof(unsigned int));
+    }
+  }
+
+  else
+  {
+    for(i = 0; i < ipow(N_contiguous, number_dimensions); i++)
+    {
+      A_matrix[i] = beta*B_matrix[i];
+    }
+    *flop += ipow(N_contiguous, number_dimensions);
+    *mop += 2*ipow(N_contiguous, number_dimensions);
+
+    /* Recompute the norms from the scaled elements, so that they stay
+     * consistent with the matrix to rounding. */
+    TYPED_FUNCTION(spamm_chunk_fix, SPAMM_TYPE)(A, flop, mop);
+  }
+}
+
+/** Multiply two SpAMM chunks.
+ *
+ * The single precision chunks are multiplied with the sgemm() passed in. The
+ * double precision chunks are multiplied with the dgemm() found by
+ * configure (DGEMM), if an sgemm() is passed in, so that the caller chooses
+ * between BLAS and the loops below in the same way for both precisions.
+ *
+ * @param tolerance The SpAMM tolerance.
+ * @param alpha The scalar alpha.
+ * @param chunk_A Chunk A.
+ * @param chunk_B Chunk B.
+ * @param chunk_C Chunk C.
+ * @param sgemm The sgemm() function to call.
+ * @param flop The flop count.
+ * @param mop The memory operation count
+ *
+ * @return The square of the norm.
+ */
+spamm_norm_t
+TYPED_FUNCTION(spamm_chunk_multiply, SPAMM_TYPE) (const spamm_norm_t tolerance,
+    const SPAMM_TYPE alpha,
+    const spamm_chunk_t *const chunk_A,
+    const spamm_chunk_t *const chunk_B,
+    spamm_chunk_t *const chunk_C,
+    sgemm_func sgemm,
+    double *const flop,
+    double *const mop)
+{
+  unsigned int i, j, k;
+
+  spamm_norm_t *norm_A;
+  spamm_norm_t *norm_B;
+
+  spamm_norm_t *norm2_C;
+
+  SPAMM_TYPE alpha_gemm = alpha;
+  SPAMM_TYPE beta = 1.0;
+
+  int N_contiguous;
+
+  SPAMM_TYPE *matrix_A;
+  SPAMM_TYPE *matrix_B;
+  SPAMM_TYPE *matrix_C;
+
+  assert(chunk_C != NULL);
+  assert(flop != NULL);
+  assert(mop != NULL);
+
+  if(chunk_A == NULL || chunk_B == NULL) { return 0.0; }
+
+  norm_A = spamm_chunk_get_norm(chunk_A);
+  norm_B = spamm_chunk_get_norm(chunk_B);
+
+  if(norm_A[0]*norm_B[0] > tolerance)
+  {
+    matrix_A = SPAMM_CHUNK_MATRIX(chunk_A);
+    matrix_B = SPAMM_CHUNK_MATRIX(chunk_B);
+    matrix_C = SPAMM_CHUNK_MATRIX(chunk_C);
+
+    N_contiguous = spamm_chunk_get_N_contiguous(chunk_A);
+
+    if(sgemm)
+    {
+#ifdef SPAMM_TYPE_SINGLE
+      sgemm("N", "N", &N_contiguous, &N_contiguous, &N_contiguous,
+          &alpha_gemm, matrix_A, &N_contiguous, matrix_B, &N_contiguous,
+          &beta, matrix_C, &N_contiguous);
+#else
+      DGEMM("N", "N", &N_contiguous, &N_contiguous, &N_contiguous,
+          &alpha_gemm, matrix_A, &N_contiguous, matrix_B, &N_contiguous,
+          &beta, matrix_C, &N_contiguous);
+#endif
+    }
+
+    else
+    {
+      /* Braindead multiply in nested loops. */
+      for(i = 0; i < N_contiguous; i++) {
+        for(j = 0; j < N_contiguous; j++) {
+          for(k = 0; k < N_contiguous; k++)
+          {
+            matrix_C[spamm_index_column_major(i, j, N_contiguous, N_contiguous)] += alpha
+              *matrix_A[spamm_index_column_major(i, k, N_contiguous, N_contiguous)]
+              *matrix_B[spamm_index_column_major(k, j, N_contiguous, N_contiguous)];
+          }
+        }
+      }
+    }
+
+    /* Update flop count. */
+    *flop += 2*N_contiguous*N_contiguous*N_contiguous;
+
+    /* Fix up norms. */
+    return TYPED_FUNCTION(spamm_chunk_fix, SPAMM_TYPE)(chunk_C, flop, mop);
+  }
+
+  else
+  {
+    norm2_C = spamm_chunk_get_norm2(chunk_C);
+    return norm2_C[0];
+  }
+}
+
+/** Count the number of non-zero elements in a chunk. The padding is zero, so
+ * it does not have to be skipped.
+ *
+ * @param chunk The chunk.
+ *
+ * @return The number of non-zero elements.
+ */
+unsigned int
+TYPED_FUNCTION(spamm_chunk_number_nonzero, SPAMM_TYPE) (const spamm_chunk_t *const chunk)
+{
+  unsigned int i;
+  unsigned int number_elements;
+  unsigned int result = 0;
+  SPAMM_TYPE *A;
+
+  A = SPAMM_CHUNK_MATRIX(chunk);
+  number_elements = ipow(spamm_chunk_get_N_contiguous(chunk), *spamm_chunk_get_number_dimensions(chunk));
+
+  for(i = 0; i < number_elements; i++)
+  {
+    result += (A[i] != 0);
+  }
+
+  return result;
+}
+
+#undef SPAMM_CHUNK_DILATED
+#undef SPAMM_CHUNK_MATRIX
@@ -7,8 +7,298 @@
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+/** Get an element of a dense matrix.
+ *
+ * @param i The row index.
+ * @param j The column index.
+ * @param N The size of the dense matrix.
+ * @param dense_type The storage type of the dense matrix.
+ * @param A_dense The dense matrix.
+ *
+ * @return The matrix element.
+ */
+static inline float
+spamm_convert_dense_get (const unsigned int i,
+    const unsigned int j,
+    const unsigned int *const N,
+    const enum spamm_layout_t dense_type,
+    const float *const A_dense)
+{
+  return A_dense[(dense_type == row_major
+      ? spamm_index_row_major(i, j, N[0], N[1])
+      : spamm_index_column_major(i, j, N[0], N[1]))];
+}
+
+/** Copy a block of a dense matrix into a new chunk.
+ *
+ * The block is scanned first, and if it is zero no chunk is allocated at
+ * all. Otherwise the elements are copied in the chunk's layout, as whole
+ * rows of basic blocks (linear tree) or whole columns (hierarchical tree)
+ * where the dense storage allows it, and the norms are fixed once at the
+ * end. The non-zero elements and the diagonal are counted on the way.
+ *
+ * @param N The size of the (unpadded) matrix.
+ * @param N_lower The lower corner of the block.
+ * @param N_upper The upper corner of the block.
+ * @param use_linear_tree Whether we are using the linear tree.
+ * @param dense_type The storage type of the dense matrix.
+ * @param A_dense The dense matrix.
+ * @param number_nonzero [out] The number of non-zero elements in the block.
+ * @param trace [out] The sum of the diagonal elements in the block.
+ *
+ * @return The new chunk, or NULL if the block is zero.
+ */
+static spamm_chunk_t *
+spamm_convert_dense_to_chunk (const unsigned int *const N,
+    const unsigned int *const N_lower,
+    const unsigned int *const N_upper,
+    const short use_linear_tree,
+    const enum spamm_layout_t dense_type,
+    const float *const A_dense,
+    unsigned int *const number_nonzero,
+    double *const trace)
+{
+  unsigned int i, j, k;
+  unsigned int i_upper, j_upper;
+  unsigned int i_kernel[2];
+  unsigned int N_contiguous;
+  unsigned int N_copy;
+  short is_zero;
+  float *A;
+  float *A_kernel;
+  spamm_chunk_t *chunk;
+
+  *number_nonzero = 0;
+  *trace = 0;
+
+  /* Skip the padding. */
+  i_upper = (N_upper[0] < N[0] ? N_upper[0] : N[0]);
+  j_upper = (N_upper[1] < N[1] ? N_upper[1] : N[1]);
+
+  for(i = N_lower[0], is_zero = 1; i < i_upper && is_zero; i++) {
+    for(j = N_lower[1]; j < j_upper; j++)
+    {
+      if(spamm_convert_dense_get(i, j, N, dense_type, A_dense) != 0)
+      {
+        is_zero = 0;
+        break;
+      }
+    }
+  }
+
+  if(is_zero) { return NULL; }
+
+  chunk = spamm_new_chunk(2, use_linear_tree, N, N_lower, N_upper);
+  N_contiguous = spamm_chunk_get_N_contiguous(chunk);
+  A = spamm_chunk_get_matrix(chunk);
+
+  i_upper -= N_lower[0];
+  j_upper -= N_lower[1];
+
+  if(!use_linear_tree)
+  {
+    /* Column-major. */
+    for(j = 0; j < j_upper; j++)
+    {
+      if(dense_type == column_major)
+      {
+        memcpy(&A[j*N_contiguous],
+            &A_dense[spamm_index_column_major(N_lower[0], N_lower[1]+j, N[0], N[1])],
+            i_upper*sizeof(float));
+      }
+
+      else
+      {
+        for(i = 0; i < i_upper; i++)
+        {
+          A[i+j*N_contiguous] = spamm_convert_dense_get(N_lower[0]+i,
+              N_lower[1]+j, N, dense_type, A_dense);
+        }
+      }
+
+      for(i = 0; i < i_upper; i++)
+      {
+        *number_nonzero += (A[i+j*N_contiguous] != 0);
+      }
+
+      if(N_lower[1]+j >= N_lower[0] && N_lower[1]+j-N_lower[0] < i_upper)
+      {
+        *trace += A[N_lower[1]+j-N_lower[0]+j*N_contiguous];
+      }
+    }
+  }
+
+  else
+  {
+    /* Z-curve ordered kernel blocks of row-major basic blocks. */
+    for(i = 0; i < i_upper; i++)
+    {
+      i_kernel[0] = i/SPAMM_N_KERNEL;
+
+      for(j = 0; j < j_upper; j += SPAMM_N_BLOCK)
+      {
+        i_kernel[1] = j/SPAMM_N_KERNEL;
+
+        A_kernel = &A[SPAMM_N_KERNEL*SPAMM_N_KERNEL*spamm_index_linear(2, i_kernel)
+          +spamm_index_kernel_block(i%SPAMM_N_KERNEL, j%SPAMM_N_KERNEL, row_major)];
+
+        N_copy = (j+SPAMM_N_BLOCK < j_upper ? SPAMM_N_BLOCK : j_upper-j);
+
+        if(dense_type == row_major)
+        {
+          memcpy(A_kernel,
+              &A_dense[spamm_index_row_major(N_lower[0]+i, N_lower[1]+j, N[0], N[1])],
+              N_copy*sizeof(float));
+        }
+
+        else
+        {
+          for(k = 0; k < N_copy; k++)
+          {
+            A_kernel[k] = spamm_convert_dense_get(N_lower[0]+i,
+                N_lower[1]+j+k, N, dense_type, A_dense);
+          }
+        }
+
+        for(k = 0; k < N_copy; k++)
+        {
+          *number_nonzero += (A_kernel[k] != 0);
+        }
+
+        if(N_lower[0]+i >= N_lower[1]+j && N_lower[0]+i-N_lower[1]-j < N_copy)
+        {
+          *trace += A_kernel[N_lower[0]+i-N_lower[1]-j];
+        }
+      }
+    }
+  }
+
+  return chunk;
+}
+
+/** Recursively build a 2-dimensional matrix from a dense matrix.
+ *
+ * The children are built as separate tasks. Nodes are only allocated for
+ * blocks that turn out to be non-zero.
+ *
+ * @param N The size of the (unpadded) matrix.
+ * @param N_lower The lower corner of this node.
+ * @param N_upper The upper corner of this node.
+ * @param tier The tier of this node.
+ * @param chunk_tier The chunk tier.
+ * @param use_linear_tree Whether we are using the linear tree.
+ * @param dense_type The storage type of the dense matrix.
+ * @param A_dense The dense matrix.
+ * @param number_nonzero [out] The number of non-zero elements below this
+ * node.
+ * @param trace [out] The sum of the diagonal elements below this node.
+ *
+ * @return The new node, or NULL if the block is zero.
+ */
+static struct spamm_recursive_node_t *
+spamm_recursive_convert_dense_to_spamm (const unsigned int *const N,
+    const unsigned int *const N_lower,
+    const unsigned int *const N_upper,
+    const unsigned int tier,
+    const unsigned int chunk_tier,
+    const short use_linear_tree,
+    const enum spamm_layout_t dense_type,
+    const float *const A_dense,
+    unsigned int *const number_nonzero,
+    double *const trace)
+{
+  short i;
+  short dim;
+  double flop = 0;
+  double mop = 0;
+  unsigned int new_N_lower[4][2];
+  unsigned int new_N_upper[4][2];
+  unsigned int child_number_nonzero[4] = { 0, 0, 0, 0 };
+  double child_trace[4] = { 0, 0, 0, 0 };
+  spamm_chunk_t *chunk;
+  struct spamm_recursive_node_t *child[4] = { NULL, NULL, NULL, NULL };
+  struct spamm_recursive_node_t *node = NULL;
+
+  *number_nonzero = 0;
+  *trace = 0;
+
+  /* Entirely in the padding. */
+  if(N_lower[0] >= N[0] || N_lower[1] >= N[1]) { return NULL; }
+
+  if(tier == chunk_tier)
+  {
+    chunk = spamm_convert_dense_to_chunk(N, N_lower, N_upper, use_linear_tree,
+        dense_type, A_dense, number_nonzero, trace);
+
+    if(chunk != NULL)
+    {
+      node = spamm_recursive_new_node();
+      node->tree.chunk = chunk;
+      node->norm2 = spamm_chunk_fix(chunk, &flop, &mop);
+      node->norm = sqrt(node->norm2);
+    }
+
+    return node;
+  }
+
+  /* Children are indexed with the row in bit 0 and the column in bit 1. */
+  for(i = 0; i < 4; i++)
+  {
+    for(dim = 0; dim < 2; dim++)
+    {
+      if(i & (1 << dim))
+      {
+        new_N_lower[i][dim] = N_lower[dim]+(N_upper[dim]-N_lower[dim])/2;
+        new_N_upper[i][dim] = N_upper[dim];
+      }
+
+      else
+      {
+        new_N_lower[i][dim] = N_lower[dim];
+        new_N_upper[i][dim] = N_lower[dim]+(N_upper[dim]-N_lower[dim])/2;
+      }
+    }
+
+#pragma omp task untied shared(child, new_N_lower, new_N_upper, \
+    child_number_nonzero, child_trace)
+    child[i] = spamm_recursive_convert_dense_to_spamm(N, new_N_lower[i],
+        new_N_upper[i], tier+1, chunk_tier, use_linear_tree, dense_type,
+        A_dense, &child_number_nonzero[i], &child_trace[i]);
+  }
+#pragma omp taskwait
+
+  for(i = 0; i < 4; i++)
+  {
+    if(child[i] == NULL) { continue; }
+
+    *number_nonzero += child_number_nonzero[i];
+    *trace += child_trace[i];
+
+    if(node == NULL)
+    {
+      node = spamm_recursive_new_node();
+      node->tree.child = calloc(4, sizeof(struct spamm_recursive_node_t*));
+    }
+
+    node->tree.child[i] = child[i];
+    node->norm2 += child[i]->norm2;
+  }
+
+  if(node != NULL)
+  {
+    node->norm = sqrt(node->norm2);
+  }
+
+  return node;
+}
 
 /** Convert a dense matrix to SpAMM.
+ *
+ * Matrices are built in bulk, one chunk at a time and in parallel, and
+ * only zero blocks are skipped. Higher rank matrices are built one element
+ * at a time with spamm_set().
  *
  * @param number_dimensions The number of dimensions.
  * @param N The number of rows/columns.
@@ -33,11 +323,42 @@ spamm_convert_dense_to_spamm (const unsigned int number_dimensions,
 {
   struct spamm_matrix_t *A;
   unsigned int *i;
+  unsigned int N_lower[2];
+  unsigned int N_upper[2];
 
   assert(A_dense != NULL);
 
   A = spamm_new(number_dimensions, N, chunk_tier, use_linear_tree);
 
+  if(number_dimensions == 2)
+  {
+    if(dense_type != row_major && dense_type != column_major)
+    {
+      SPAMM_FATAL("unknown type\n");
+    }
+
+    N_lower[0] = 0;
+    N_lower[1] = 0;
+    N_upper[0] = A->N_padded;
+    N_upper[1] = A->N_padded;
+
+#pragma omp parallel
+    {
+#pragma omp single
+      {
+#pragma omp task untied
+        A->recursive_tree = spamm_recursive_convert_dense_to_spamm(A->N,
+            N_lower, N_upper, 0, A->chunk_tier, A->use_linear_tree,
+            dense_type, A_dense, &A->number_nonzero, &A->trace);
+      }
+    }
+
+    A->number_nonzero_valid = 1;
+    A->trace_valid = 1;
+
+    return A;
+  }
+
   i = calloc(number_dimensions, sizeof(unsigned int));
 
   switch(number_dimensions)
@@ -59,28 +380,6 @@ spamm_convert_dense_to_spamm (const unsigned int number_dimensions,
       }
       break;
 
-    case 2:
-      for(i[0] = 0; i[0] < N[0]; i[0]++) {
-        for(i[1] = 0; i[1] < N[1]; i[1]++)
-        {
-          switch(dense_type)
-          {
-            case row_major:
-              spamm_set(i, A_dense[spamm_index_row_major(i[0], i[1], N[0], N[1])], A);
-              break;
-
-            case column_major:
-              spamm_set(i, A_dense[spamm_index_column_major(i[0], i[1], N[0], N[1])], A);
-              break;
-
-            default:
-              SPAMM_FATAL("unknown type\n");
-              break;
-          }
-        }
-      }
-      break;
-
     case 3:
       for(i[0] = 0; i[0] < N[0]; i[0]++) {
         for(i[1] = 0; i[1] < N[1]; i[1]++) {
@@ -16,33 +16,13 @@
  */
 void
 spamm_chunk_copy (spamm_chunk_t **A,
-    const float beta,
+    const double beta,
     spamm_chunk_t *B,
     const short use_linear_tree,
     double *const flop,
     double *const mop)
 {
-  unsigned int number_dimensions;
-  unsigned int number_tiers;
-  unsigned int *N;
-  unsigned int *N_lower;
-  unsigned int *N_upper;
-
-  spamm_norm_t *norm_A;
-  spamm_norm_t *norm2_A;
-  spamm_norm_t *norm2_B;
-
-  float *A_matrix;
-  float *B_matrix;
-
-  float *A_matrix_dilated;
-
-  unsigned int N_contiguous;
-
-  unsigned int i;
-  unsigned int i_norm;
-
-  unsigned int tier;
+  enum spamm_precision_t precision;
 
   assert(A != NULL);
   assert(B != NULL);
@@ -51,64 +31,21 @@ spamm_chunk_copy (spamm_chunk_t **A,
 
   spamm_delete_chunk(A);
 
-  number_dimensions = *spamm_chunk_get_number_dimensions(B);
-  number_tiers = *spamm_chunk_get_number_tiers(B);
-  N = spamm_chunk_get_N(B);
-  N_lower = spamm_chunk_get_N_lower(B);
-  N_upper = spamm_chunk_get_N_upper(B);
+  precision = *spamm_chunk_get_precision(B);
 
   /* Allocate memory for new chunk. */
-  *A = spamm_new_chunk(number_dimensions, use_linear_tree, N, N_lower, N_upper);
-
-  norm_A = spamm_chunk_get_norm(*A);
-  norm2_A = spamm_chunk_get_norm2(*A);
-  norm2_B = spamm_chunk_get_norm2(B);
+  *A = spamm_new_chunk_precision(*spamm_chunk_get_number_dimensions(B),
+      use_linear_tree, precision, spamm_chunk_get_N(B),
+      spamm_chunk_get_N_lower(B), spamm_chunk_get_N_upper(B));
 
-  /* Update norms. */
-  for(tier = 0, i_norm = 0; tier < number_tiers; tier++)
+  if(precision == double_precision)
   {
-    for(i = 0; i < ipow(ipow(2, number_dimensions), tier); i++)
-    {
-      norm2_A[i_norm] = beta*beta*norm2_B[i_norm];
-      norm_A[i_norm] = sqrt(norm2_A[i_norm]);
-      i_norm++;
-    }
-  }
-
-  N_contiguous = spamm_chunk_get_N_contiguous(B);
-
-  A_matrix = spamm_chunk_get_matrix(*A);
-  B_matrix = spamm_chunk_get_matrix(B);
-
-  A_matrix_dilated = spamm_chunk_get_matrix_dilated(*A);
-
-  /* Copy matrix elements. */
-  if(beta == 1.0)
-  {
-    for(i = 0; i < ipow(N_contiguous, number_dimensions); i++)
-    {
-      A_matrix[i] = beta*B_matrix[i];
-
-      A_matrix_dilated[4*i+0] = A_matrix[i];
-      A_matrix_dilated[4*i+1] = A_matrix[i];
-      A_matrix_dilated[4*i+2] = A_matrix[i];
-      A_matrix_dilated[4*i+3] = A_matrix[i];
-    }
+    spamm_chunk_copy_matrix_double(*A, beta, B, flop, mop);
   }
 
   else
   {
-    for(i = 0; i < ipow(N_contiguous, number_dimensions); i++)
-    {
-      A_matrix[i] = beta*B_matrix[i];
-
-      A_matrix_dilated[4*i+0] = A_matrix[i];
-      A_matrix_dilated[4*i+1] = A_matrix[i];
-      A_matrix_dilated[4*i+2] = A_matrix[i];
-      A_matrix_dilated[4*i+3] = A_matrix[i];
-    }
-    *flop += ipow(N_contiguous, number_dimensions);
-    *mop += 4*ipow(N_contiguous, number_dimensions);
+    spamm_chunk_copy_matrix_float(*A, beta, B, flop, mop);
   }
 }
 
@@ -122,7 +59,7 @@ spamm_chunk_copy (spamm_chunk_t **A,
  */
 void
 spamm_recursive_copy (struct spamm_recursive_node_t *const A,
-    const float beta,
+    const double beta,
     const struct spamm_recursive_node_t *const B,
     const unsigned int number_dimensions,
     const unsigned int tier,
@@ -141,13 +78,13 @@ spamm_recursive_copy (struct spamm_recursive_node_t *const A,
 
   if(tier == chunk_tier)
   {
-#ifdef _OPENMP
+#ifdef SPAMM_NODE_LOCK
     omp_set_lock(&A->lock);
 #endif
 
     spamm_chunk_copy(&A->tree.chunk, beta, B->tree.chunk, use_linear_tree, flop, mop);
 
-#ifdef _OPENMP
+#ifdef SPAMM_NODE_LOCK
     omp_unset_lock(&A->lock);
 #endif
   }
@@ -159,7 +96,7 @@ spamm_recursive_copy (struct spamm_recursive_node_t *const A,
       return;
     }
 
-#ifdef _OPENMP
+#ifdef SPAMM_NODE_LOCK
     omp_set_lock(&A->lock);
 #endif
 
@@ -176,7 +113,7 @@ spamm_recursive_copy (struct spamm_recursive_node_t *const A,
       }
     }
 
-#ifdef _OPENMP
+#ifdef SPAMM_NODE_LOCK
     omp_unset_lock(&A->lock);
 #endif
 
@@ -193,14 +130,28 @@ spamm_recursive_copy (struct spamm_recursive_node_t *const A,
 #pragma omp taskwait
   }
 
-#ifdef _OPENMP
+#ifdef SPAMM_NODE_LOCK
     omp_set_lock(&A->lock);
 #endif
 
-  A->norm2 = beta*beta*B->norm2;
+  if(tier == chunk_tier)
+  {
+    A->norm2 = (A->tree.chunk == NULL ? 0 : spamm_chunk_get_norm2(A->tree.chunk)[0]);
+  }
+
+  else
+  {
+    for(i = 0, A->norm2 = 0; i < ipow(2, number_dimensions); i++)
+    {
+      if(A->tree.child[i] != NULL)
+      {
+        A->norm2 += A->tree.child[i]->norm2;
+      }
+    }
+  }
   A->norm = sqrt(A->norm2);
 
-#ifdef _OPENMP
+#ifdef SPAMM_NODE_LOCK
     omp_unset_lock(&A->lock);
 #endif
 }
@@ -215,7 +166,7 @@ spamm_recursive_copy (struct spamm_recursive_node_t *const A,
  */
 void
 spamm_copy (struct spamm_matrix_t **A,
-    const float beta,
+    const double beta,
     const struct spamm_matrix_t *const B,
     double *const flop,
     double *const mop)
@@ -228,7 +179,8 @@ spamm_copy (struct spamm_matrix_t **A,
 
   if(B == NULL) { return; }
 
-  *A = spamm_new(B->number_dimensions, B->N, B->chunk_tier, B->use_linear_tree);
+  *A = spamm_new_precision(B->number_dimensions, B->N, B->chunk_tier,
+      B->use_linear_tree, B->precision);
   (*A)->recursive_tree = spamm_recursive_new_node();
 
 #pragma omp parallel
@@ -241,4 +193,9 @@ spamm_copy (struct spamm_matrix_t **A,
           mop);
     }
   }
+
+  (*A)->number_nonzero = (beta == 0 ? 0 : B->number_nonzero);
+  (*A)->number_nonzero_valid = B->number_nonzero_valid || beta == 0;
+  (*A)->trace = beta*B->trace;
+  (*A)->trace_valid = B->trace_valid;
 }
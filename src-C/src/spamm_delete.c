@@ -58,7 +58,7 @@ spamm_recursive_delete (const unsigned int number_dimensions,
         spamm_recursive_delete(number_dimensions, tier+1, chunk_tier, &(*node)->tree.child[i]);
       }
 
-#ifdef _OPENMP
+#ifdef SPAMM_NODE_LOCK
       omp_destroy_lock(&(*node)->lock);
 #endif
       free((*node)->tree.child);
@@ -161,6 +161,9 @@ spamm_error_fatal (const char *const filename, const int line, ...)
   printf("\n");
   spamm_error_print_backtrace();
 
+  /* Do not lose the message if stdout is a pipe. */
+  fflush(stdout);
+
   /* Exit with signal so debuggers can produce a backtrace. */
   abort();
 }
@@ -27,14 +27,14 @@ spamm_check (const struct spamm_matrix_t *A,
 
 void
 spamm_copy (struct spamm_matrix_t **A,
-    const float beta,
+    const double beta,
     const struct spamm_matrix_t *const B,
     double *const flop,
     double *const memop);
 
 void
 spamm_chunk_copy (spamm_chunk_t **A,
-    const float beta,
+    const double beta,
     spamm_chunk_t *B,
     const short use_linear_tree,
     double *const flop,
@@ -42,7 +42,7 @@ spamm_chunk_copy (spamm_chunk_t **A,
 
 void
 spamm_recursive_copy (struct spamm_recursive_node_t *const A,
-    const float beta,
+    const double beta,
     const struct spamm_recursive_node_t *const B,
     const unsigned int number_dimensions,
     const unsigned int tier,
@@ -114,6 +114,10 @@ float
 spamm_get (const unsigned int *const i,
     const struct spamm_matrix_t *const A);
 
+double
+spamm_get_double (const unsigned int *const i,
+    const struct spamm_matrix_t *const A);
+
 spamm_norm_t
 spamm_get_norm (const struct spamm_matrix_t *const A);
 
@@ -139,17 +143,25 @@ spamm_index_3D_i0j_to_2D (const unsigned int index_3D_i0j);
 unsigned int
 spamm_index_3D_ikj_to_k (const unsigned int index_3D_ikj);
 
+void
+spamm_multiply_bucket_stream (const unsigned int stream_length,
+    const unsigned int number_buckets,
+    unsigned int *const stream,
+    unsigned int *const work,
+    unsigned int *const bucket_offset);
+
 spamm_norm_t
 spamm_linear_multiply (const spamm_norm_t tolerance,
-    const float alpha,
+    const double alpha,
     const spamm_chunk_t *const chunk_A,
     const spamm_chunk_t *const chunk_B,
     spamm_chunk_t *const chunk_C,
+    struct spamm_multiply_scratch_t *const scratch,
     double *const flop,
     double *const memop);
 
 void
-spamm_recursive_multiply_scalar (const float alpha,
+spamm_recursive_multiply_scalar (const double alpha,
     struct spamm_recursive_node_t *A,
     const unsigned int number_dimensions,
     const unsigned int tier,
@@ -159,32 +171,40 @@ spamm_recursive_multiply_scalar (const float alpha,
     double *const memop);
 
 void
-spamm_multiply_scalar (const float alpha,
+spamm_multiply_scalar (const double alpha,
     struct spamm_matrix_t *const A,
     double *const flop,
     double *const memop);
 
 void
 spamm_multiply (const spamm_norm_t tolerance,
-    const float alpha,
+    const double alpha,
     const struct spamm_matrix_t *const A,
     const struct spamm_matrix_t *const B,
-    const float beta,
+    const double beta,
     struct spamm_matrix_t *const C,
     sgemm_func sgemm,
     double *const flop,
     double *const memop);
 
 void
-spamm_add (const float alpha,
+spamm_add (const double alpha,
     struct spamm_matrix_t *const A,
-    const float beta,
+    const double beta,
     const struct spamm_matrix_t *const B,
     double *const flop,
     double *const memop);
 
 unsigned int
-spamm_number_nonzero (const struct spamm_matrix_t *A);
+spamm_number_nonzero (struct spamm_matrix_t *const A);
+
+spamm_chunk_t *
+spamm_new_chunk_precision (const unsigned int number_dimensions,
+    const short use_linear_tree,
+    const enum spamm_precision_t precision,
+    const unsigned int *const N,
+    const unsigned int *const N_lower,
+    const unsigned int *const N_upper);
 
 spamm_chunk_t *
 spamm_new_chunk (const unsigned int number_dimensions,
@@ -193,6 +213,13 @@ spamm_new_chunk (const unsigned int number_dimensions,
     const unsigned int *const N_lower,
     const unsigned int *const N_upper);
 
+struct spamm_matrix_t *
+spamm_new_precision (const unsigned int number_dimensions,
+    const unsigned int *const N,
+    const unsigned int chunk_tier,
+    const short use_linear_tree,
+    const enum spamm_precision_t precision);
+
 struct spamm_matrix_t *
 spamm_new (const unsigned int number_dimensions,
     const unsigned int *const N,
@@ -209,7 +236,7 @@ void
 spamm_matlab_print (const struct spamm_matrix_t *const A);
 
 void
-spamm_print_info (const struct spamm_matrix_t *const A);
+spamm_print_info (struct spamm_matrix_t *const A);
 
 void
 spamm_print_chunk (const spamm_chunk_t *const chunk);
@@ -224,6 +251,9 @@ spamm_print_dense (const unsigned int M, const unsigned int N,
 void
 spamm_set (const unsigned int *const i, const float Aij, struct spamm_matrix_t *A);
 
+void
+spamm_set_double (const unsigned int *const i, const double Aij, struct spamm_matrix_t *A);
+
 void
 spamm_uint_to_bin_string (const unsigned int width, const unsigned int i, char *result);
 
@@ -246,6 +276,11 @@ spamm_spectral_bounds (float *const a_min,
     float *const a_max,
     struct spamm_matrix_t *A);
 
+void
+spamm_spectral_bounds_norm (float *const a_min,
+    float *const a_max,
+    const struct spamm_matrix_t *const A);
+
 void
 spamm_sort_masked (const unsigned int length,
     unsigned int *const list,
@@ -266,7 +301,7 @@ spamm_chunk_get_total_number_norms (const unsigned int number_tiers,
     const unsigned int number_dimensions);
 
 float
-spamm_trace (const struct spamm_matrix_t *const A,
+spamm_trace (struct spamm_matrix_t *const A,
     double *const flop);
 
 void
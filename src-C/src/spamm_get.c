@@ -15,11 +15,11 @@
  *
  * @return The matrix element.
  */
-float
+double
 spamm_chunk_get (const unsigned int *i,
     spamm_chunk_t *chunk)
 {
-  float Aij = 0;
+  double Aij = 0;
 
   short use_linear_tree;
 
@@ -28,8 +28,6 @@ spamm_chunk_get (const unsigned int *i,
   unsigned int *N_lower;
   unsigned int *N_upper;
 
-  float *A;
-
   if(chunk == NULL) { return 0.0; }
 
   number_dimensions = *spamm_chunk_get_number_dimensions(chunk);
@@ -38,9 +36,8 @@ spamm_chunk_get (const unsigned int *i,
   N_lower = spamm_chunk_get_N_lower(chunk);
   N_upper = spamm_chunk_get_N_upper(chunk);
 
-  A = spamm_chunk_get_matrix(chunk);
-
-  Aij = A[spamm_chunk_matrix_index(number_dimensions, use_linear_tree, N_lower, N_upper, i)];
+  Aij = spamm_chunk_get_matrix_element(spamm_chunk_matrix_index(number_dimensions,
+        use_linear_tree, N_lower, N_upper, i), chunk);
 
   return Aij;
 }
@@ -54,7 +51,7 @@ spamm_chunk_get (const unsigned int *i,
  *
  * @return The matrix element Aij.
  */
-float
+double
 spamm_recursive_get (const unsigned int number_dimensions,
     const unsigned int *const i,
     const unsigned int *const N_lower,
@@ -66,12 +63,12 @@ spamm_recursive_get (const unsigned int number_dimensions,
 {
   int dim;
 
-  unsigned int *new_N_lower;
-  unsigned int *new_N_upper;
+  unsigned int new_N_lower[SPAMM_MAX_NUMBER_DIMENSIONS];
+  unsigned int new_N_upper[SPAMM_MAX_NUMBER_DIMENSIONS];
 
   short child_index;
 
-  float Aij;
+  double Aij = 0;
 
   if(node == NULL) { return 0; }
 
@@ -84,9 +81,6 @@ spamm_recursive_get (const unsigned int number_dimensions,
   {
     if(node->tree.child != NULL)
     {
-      new_N_lower = calloc(number_dimensions, sizeof(unsigned int));
-      new_N_upper = calloc(number_dimensions, sizeof(unsigned int));
-
       child_index = 0;
 
       for(dim = 0; dim < number_dimensions; dim++)
@@ -107,48 +101,54 @@ spamm_recursive_get (const unsigned int number_dimensions,
 
       Aij = spamm_recursive_get(number_dimensions, i, new_N_lower, new_N_upper,
           tier+1, chunk_tier, use_linear_tree, node->tree.child[child_index]);
-
-      free(new_N_lower);
-      free(new_N_upper);
     }
   }
 
   return Aij;
 }
 
-/** Get an element from a matrix.
+/** Get an element from a matrix, in double precision.
  *
  * @param i The row/column index.
  * @param A The matrix.
  *
  * @return The matrix element.
  */
-float
-spamm_get (const unsigned int *const i,
+double
+spamm_get_double (const unsigned int *const i,
     const struct spamm_matrix_t *const A)
 {
-  unsigned int *N_lower;
-  unsigned int *N_upper;
+  unsigned int N_lower[SPAMM_MAX_NUMBER_DIMENSIONS];
+  unsigned int N_upper[SPAMM_MAX_NUMBER_DIMENSIONS];
 
   int dim;
 
-  float Aij;
+  double Aij;
 
   assert(A != NULL);
 
-  N_lower = calloc(A->number_dimensions, sizeof(unsigned int));
-  N_upper = calloc(A->number_dimensions, sizeof(unsigned int));
-
   for(dim = 0; dim < A->number_dimensions; dim++)
   {
+    N_lower[dim] = 0;
     N_upper[dim] = A->N_padded;
   }
 
   Aij = spamm_recursive_get(A->number_dimensions, i, N_lower, N_upper, 0,
       A->chunk_tier, A->use_linear_tree, A->recursive_tree);
 
-  free(N_lower);
-  free(N_upper);
-
   return Aij;
 }
+
+/** Get an element from a matrix.
+ *
+ * @param i The row/column index.
+ * @param A The matrix.
+ *
+ * @return The matrix element.
+ */
+float
+spamm_get (const unsigned int *const i,
+    const struct spamm_matrix_t *const A)
+{
+  return spamm_get_double(i, A);
+}
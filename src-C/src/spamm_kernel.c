@@ -9,7 +9,7 @@
 #include <strings.h>
 
 /** Available stream kernels. */
-#define SPAMM_NUMBER_KERNELS 4
+#define SPAMM_NUMBER_KERNELS 7
 
 /** Get the name of the ith kernel.
  *
@@ -25,7 +25,10 @@ spamm_kernel_get_name (const unsigned int i)
     "kernel_external_sgemm",
     "kernel_stream_NULL",
     "kernel_standard_SSE",
-    "kernel_standard_SSE4_1"
+    "kernel_standard_SSE4_1",
+    "kernel_standard_C",
+    "kernel_standard_AVX2",
+    "kernel_standard_AVX512"
   };
 
   if(i >= SPAMM_NUMBER_KERNELS)
@@ -67,6 +70,21 @@ spamm_kernel_get_kernel (const char* name)
     kernel = kernel_standard_SSE4_1;
   }
 
+  else if(strcasecmp(name, "kernel_standard_C") == 0)
+  {
+    kernel = kernel_standard_C;
+  }
+
+  else if(strcasecmp(name, "kernel_standard_AVX2") == 0)
+  {
+    kernel = kernel_standard_AVX2;
+  }
+
+  else if(strcasecmp(name, "kernel_standard_AVX512") == 0)
+  {
+    kernel = kernel_standard_AVX512;
+  }
+
   else
   {
     SPAMM_FATAL("unknown kernel: %s\n", name);
@@ -95,6 +113,9 @@ spamm_kernel_suggest_layout (const enum spamm_kernel_t kernel)
 
     case kernel_standard_SSE:
     case kernel_standard_SSE4_1:
+    case kernel_standard_C:
+    case kernel_standard_AVX2:
+    case kernel_standard_AVX512:
       return row_major;
       break;
 
@@ -145,3 +166,176 @@ spamm_kernel_get_layout (const char *name)
 
   return layout;
 }
+
+/** @private Check whether the CPU we are running on can run a stream
+ * kernel, and whether that kernel was built into the library. The CPU is
+ * only probed on x86, elsewhere only the C kernel is supported.
+ *
+ * @param kernel The kernel.
+ *
+ * @return 1 if the kernel can be run, 0 otherwise.
+ */
+static int
+spamm_kernel_is_supported (const enum spamm_kernel_t kernel)
+{
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_cpu_init();
+
+  switch(kernel)
+  {
+    case kernel_standard_SSE:
+    case kernel_standard_SSE4_1:
+#ifdef RUN_ASSEMBLY_KERNEL
+#ifdef SPAMM_USE_DILATED_MATRIX
+      return __builtin_cpu_supports("sse");
+#else
+      /* The elements of A are loaded with vbroadcastss. */
+      return __builtin_cpu_supports("avx");
+#endif
+#else
+      return 0;
+#endif
+
+    case kernel_standard_C:
+      return 1;
+
+    case kernel_standard_AVX2:
+#ifdef HAVE_AVX2_KERNEL
+      return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#else
+      return 0;
+#endif
+
+    case kernel_standard_AVX512:
+#ifdef HAVE_AVX512_KERNEL
+      return __builtin_cpu_supports("avx512f");
+#else
+      return 0;
+#endif
+
+    default:
+      return 0;
+  }
+#else
+  return (kernel == kernel_standard_C);
+#endif
+}
+
+/** Select the stream kernel to run the linear tier products with.
+ *
+ * The fastest kernel which the CPU supports is chosen, in the order
+ * AVX-512, AVX2, SSE (the assembly kernel, if enabled), and finally the
+ * portable C kernel. The choice can be overridden by setting the
+ * environment variable SPAMM_KERNEL to the name of a kernel. The selection is
+ * done once, and cached.
+ *
+ * @return The stream kernel.
+ */
+enum spamm_kernel_t
+spamm_kernel_select (void)
+{
+  static int selected_kernel = -1;
+
+  int cached_kernel;
+  enum spamm_kernel_t kernel;
+  char *kernel_name;
+
+#pragma omp atomic read
+  cached_kernel = selected_kernel;
+
+  if(cached_kernel >= 0)
+  {
+    return (enum spamm_kernel_t) cached_kernel;
+  }
+
+  if((kernel_name = getenv("SPAMM_KERNEL")) != NULL && kernel_name[0] != '\0')
+  {
+    kernel = spamm_kernel_get_kernel(kernel_name);
+
+    if(!spamm_kernel_is_supported(kernel))
+    {
+      SPAMM_FATAL("%s is not supported on this CPU or in this build\n", kernel_name);
+    }
+  }
+
+  else if(spamm_kernel_is_supported(kernel_standard_AVX512))
+  {
+    kernel = kernel_standard_AVX512;
+  }
+
+  else if(spamm_kernel_is_supported(kernel_standard_AVX2))
+  {
+    kernel = kernel_standard_AVX2;
+  }
+
+  else if(spamm_kernel_is_supported(kernel_standard_SSE))
+  {
+    kernel = kernel_standard_SSE;
+  }
+
+  else
+  {
+    kernel = kernel_standard_C;
+  }
+
+#pragma omp atomic write
+  selected_kernel = kernel;
+
+  return kernel;
+}
+
+/** Run a stream kernel.
+ *
+ * @param kernel The stream kernel, typically from spamm_kernel_select().
+ * @param number_stream_elements The size of the stream array.
+ * @param alpha The factor alpha
+ * @param tolerance The SpAMM tolerance.
+ * @param stream The stream index array.
+ * @param chunk_A The A matrix chunk.
+ * @param chunk_B The B matrix chunk.
+ * @param chunk_C The C matrix chunk.
+ * @param flop The flop count. The assembly kernel does not count its flops.
+ */
+void
+spamm_kernel_stream_run (const enum spamm_kernel_t kernel,
+    const unsigned int number_stream_elements,
+    float alpha,
+    spamm_norm_t tolerance,
+    unsigned int *stream,
+    const void *const chunk_A,
+    const void *const chunk_B,
+    void *const chunk_C,
+    double *const flop)
+{
+  switch(kernel)
+  {
+    case kernel_standard_SSE:
+    case kernel_standard_SSE4_1:
+      spamm_stream_kernel(number_stream_elements, alpha, tolerance, stream,
+          chunk_A, chunk_B, chunk_C);
+      break;
+
+    case kernel_standard_C:
+      spamm_stream_kernel_C_float(number_stream_elements, alpha, tolerance, stream,
+          chunk_A, chunk_B, chunk_C, flop);
+      break;
+
+#ifdef HAVE_AVX2_KERNEL
+    case kernel_standard_AVX2:
+      spamm_stream_kernel_AVX2(number_stream_elements, alpha, tolerance,
+          stream, chunk_A, chunk_B, chunk_C, flop);
+      break;
+#endif
+
+#ifdef HAVE_AVX512_KERNEL
+    case kernel_standard_AVX512:
+      spamm_stream_kernel_AVX512(number_stream_elements, alpha, tolerance,
+          stream, chunk_A, chunk_B, chunk_C, flop);
+      break;
+#endif
+
+    default:
+      SPAMM_FATAL("%s is not a stream kernel\n", spamm_kernel_get_name(kernel));
+      break;
+  }
+}
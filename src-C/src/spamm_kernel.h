@@ -31,7 +31,16 @@ enum spamm_kernel_t
   kernel_standard_SSE,
 
   /** The standard stream kernel (SSE4.1). */
-  kernel_standard_SSE4_1
+  kernel_standard_SSE4_1,
+
+  /** The standard stream kernel (portable C). */
+  kernel_standard_C,
+
+  /** The standard stream kernel (AVX2 and FMA). */
+  kernel_standard_AVX2,
+
+  /** The standard stream kernel (AVX-512). */
+  kernel_standard_AVX512
 };
 
 const char *
@@ -46,6 +55,20 @@ spamm_kernel_suggest_layout (const enum spamm_kernel_t kernel);
 enum spamm_layout_t
 spamm_kernel_get_layout (const char *name);
 
+enum spamm_kernel_t
+spamm_kernel_select (void);
+
+void
+spamm_kernel_stream_run (const enum spamm_kernel_t kernel,
+    const unsigned int number_stream_elements,
+    float alpha,
+    spamm_norm_t tolerance,
+    unsigned int *stream,
+    const void *const chunk_A,
+    const void *const chunk_B,
+    void *const chunk_C,
+    double *const flop);
+
 /** The stream kernel.
  *
  * @param number_stream_elements The size of the stream array.
@@ -65,6 +88,46 @@ spamm_stream_kernel (const unsigned int number_stream_elements,
     const void *const chunk_B,
     void *const chunk_C);
 
+void
+spamm_stream_kernel_C_float (const unsigned int number_stream_elements,
+    float alpha,
+    spamm_norm_t tolerance,
+    unsigned int *stream,
+    const void *const chunk_A,
+    const void *const chunk_B,
+    void *const chunk_C,
+    double *const flop);
+
+void
+spamm_stream_kernel_C_double (const unsigned int number_stream_elements,
+    double alpha,
+    spamm_norm_t tolerance,
+    unsigned int *stream,
+    const void *const chunk_A,
+    const void *const chunk_B,
+    void *const chunk_C,
+    double *const flop);
+
+void
+spamm_stream_kernel_AVX2 (const unsigned int number_stream_elements,
+    float alpha,
+    spamm_norm_t tolerance,
+    unsigned int *stream,
+    const void *const chunk_A,
+    const void *const chunk_B,
+    void *const chunk_C,
+    double *const flop);
+
+void
+spamm_stream_kernel_AVX512 (const unsigned int number_stream_elements,
+    float alpha,
+    spamm_norm_t tolerance,
+    unsigned int *stream,
+    const void *const chunk_A,
+    const void *const chunk_B,
+    void *const chunk_C,
+    double *const flop);
+
 __END_DECLARATIONS
 
 #endif
@@ -0,0 +1,284 @@
+/** @file spamm_kernel_stream.c
+ *
+ * The stream kernels written in C. The stream is a list of {A, B, C} kernel
+ * block index triples, bucketed by the C index (see
+ * spamm_multiply_bucket_stream()), such that each run of equal C indices can
+ * be accumulated with its C basic block kept in registers. The kernel blocks
+ * consist of SPAMM_N_KERNEL_BLOCKED x SPAMM_N_KERNEL_BLOCKED row-major basic
+ * blocks of SPAMM_N_BLOCK x SPAMM_N_BLOCK row-major elements, and every
+ * basic block product is skipped if the product of the norms of A and B is
+ * below the tolerance.
+ *
+ * The C kernel is generated from spamm_kernel_stream_source.c for single and
+ * double precision chunks, the other kernels are single precision only.
+ *
+ * The AVX2 and AVX-512 kernels are compiled for their instruction set with a
+ * function attribute, so that the library itself can be built for a generic
+ * target, and the kernel is chosen at run time by spamm_kernel_select().
+ */
+
+#include "config.h"
+#include "spamm.h"
+#include "spamm_types_private.h"
+#include "typed_function.h"
+
+#if defined(HAVE_AVX2_KERNEL) || defined(HAVE_AVX512_KERNEL)
+#include <immintrin.h>
+#endif
+
+#if SPAMM_N_BLOCK != 4
+#error "the stream kernels assume 4x4 basic blocks"
+#endif
+
+/** @private Get the end of the run of stream elements starting at i_stream
+ * which accumulate into the same C kernel block.
+ *
+ * @param number_stream_elements The size of the stream array.
+ * @param i_stream The start of the run.
+ * @param stream The stream index array.
+ *
+ * @return The index of the first stream element of the next run.
+ */
+static inline unsigned int
+spamm_kernel_stream_run_end (const unsigned int number_stream_elements,
+    const unsigned int i_stream,
+    const unsigned int *const stream)
+{
+  unsigned int i_end;
+
+  for(i_end = i_stream+1; i_end < number_stream_elements
+      && stream[3*i_end+2] == stream[3*i_stream+2]; i_end++) {}
+
+  return i_end;
+}
+
+#define SPAMM_TYPE float
+#define SPAMM_STREAM_KERNEL_MATRIX spamm_chunk_get_matrix
+#include "spamm_kernel_stream_source.c"
+#undef SPAMM_STREAM_KERNEL_MATRIX
+#undef SPAMM_TYPE
+
+#define SPAMM_TYPE double
+#define SPAMM_STREAM_KERNEL_MATRIX spamm_chunk_get_matrix_double
+#include "spamm_kernel_stream_source.c"
+#undef SPAMM_STREAM_KERNEL_MATRIX
+#undef SPAMM_TYPE
+
+#ifdef HAVE_AVX2_KERNEL
+/** The stream kernel, using AVX2 and FMA.
+ *
+ * A C basic block is held in two 256-bit registers of two rows each. Row k of
+ * the B basic block is broadcast into both 128-bit lanes, and multiplied with
+ * A(i,k) and A(i+1,k), which are splatted in place within the lanes of the
+ * A rows, so that a basic block product takes 8 fused multiply-adds.
+ *
+ * @param number_stream_elements The size of the stream array.
+ * @param alpha The factor alpha
+ * @param tolerance The SpAMM tolerance.
+ * @param stream The stream index array.
+ * @param chunk_A The A matrix chunk.
+ * @param chunk_B The B matrix chunk.
+ * @param chunk_C The C matrix chunk.
+ * @param flop The flop count.
+ */
+__attribute__((target("avx2,fma")))
+void
+spamm_stream_kernel_AVX2 (const unsigned int number_stream_elements,
+    float alpha,
+    spamm_norm_t tolerance,
+    unsigned int *stream,
+    const void *const chunk_A,
+    const void *const chunk_B,
+    void *const chunk_C,
+    double *const flop)
+{
+  unsigned int i_stream, i_end, i_run;
+  unsigned int i, j, k;
+  unsigned int number_products = 0;
+
+  spamm_norm_t *norm_A;
+  spamm_norm_t *norm_B;
+
+  float *matrix_A;
+  float *matrix_B;
+  float *matrix_C;
+
+  float *A_block;
+  float *B_block;
+  float *C_block;
+
+  __m256 alpha_v;
+  __m256 A_01, A_23;
+  __m256 B_0, B_1, B_2, B_3;
+  __m256 C_01, C_23;
+
+  norm_A = spamm_chunk_get_tier_norm(*spamm_chunk_get_number_tiers(chunk_A)-1, chunk_A);
+  norm_B = spamm_chunk_get_tier_norm(*spamm_chunk_get_number_tiers(chunk_B)-1, chunk_B);
+
+  matrix_A = spamm_chunk_get_matrix(chunk_A);
+  matrix_B = spamm_chunk_get_matrix(chunk_B);
+  matrix_C = spamm_chunk_get_matrix(chunk_C);
+
+  alpha_v = _mm256_set1_ps(alpha);
+
+  for(i_stream = 0; i_stream < number_stream_elements; i_stream = i_end)
+  {
+    i_end = spamm_kernel_stream_run_end(number_stream_elements, i_stream, stream);
+
+    for(i = 0; i < SPAMM_N_KERNEL_BLOCKED; i++) {
+      for(j = 0; j < SPAMM_N_KERNEL_BLOCKED; j++)
+      {
+        C_block = &matrix_C[stream[3*i_stream+2]*SPAMM_N_KERNEL*SPAMM_N_KERNEL
+          +(i*SPAMM_N_KERNEL_BLOCKED+j)*SPAMM_N_BLOCK*SPAMM_N_BLOCK];
+
+        C_01 = _mm256_loadu_ps(&C_block[0]);
+        C_23 = _mm256_loadu_ps(&C_block[8]);
+
+        for(i_run = i_stream; i_run < i_end; i_run++) {
+          for(k = 0; k < SPAMM_N_KERNEL_BLOCKED; k++)
+          {
+            if(norm_A[stream[3*i_run+0]*SPAMM_N_KERNEL_BLOCKED*SPAMM_N_KERNEL_BLOCKED+i*SPAMM_N_KERNEL_BLOCKED+k]
+                *norm_B[stream[3*i_run+1]*SPAMM_N_KERNEL_BLOCKED*SPAMM_N_KERNEL_BLOCKED+k*SPAMM_N_KERNEL_BLOCKED+j]
+                <= tolerance) { continue; }
+
+            A_block = &matrix_A[stream[3*i_run+0]*SPAMM_N_KERNEL*SPAMM_N_KERNEL
+              +(i*SPAMM_N_KERNEL_BLOCKED+k)*SPAMM_N_BLOCK*SPAMM_N_BLOCK];
+            B_block = &matrix_B[stream[3*i_run+1]*SPAMM_N_KERNEL*SPAMM_N_KERNEL
+              +(k*SPAMM_N_KERNEL_BLOCKED+j)*SPAMM_N_BLOCK*SPAMM_N_BLOCK];
+
+            A_01 = _mm256_loadu_ps(&A_block[0]);
+            A_23 = _mm256_loadu_ps(&A_block[8]);
+
+            B_0 = _mm256_mul_ps(alpha_v, _mm256_broadcast_ps((const __m128*) &B_block[0]));
+            B_1 = _mm256_mul_ps(alpha_v, _mm256_broadcast_ps((const __m128*) &B_block[4]));
+            B_2 = _mm256_mul_ps(alpha_v, _mm256_broadcast_ps((const __m128*) &B_block[8]));
+            B_3 = _mm256_mul_ps(alpha_v, _mm256_broadcast_ps((const __m128*) &B_block[12]));
+
+            C_01 = _mm256_fmadd_ps(_mm256_permute_ps(A_01, 0x00), B_0, C_01);
+            C_23 = _mm256_fmadd_ps(_mm256_permute_ps(A_23, 0x00), B_0, C_23);
+            C_01 = _mm256_fmadd_ps(_mm256_permute_ps(A_01, 0x55), B_1, C_01);
+            C_23 = _mm256_fmadd_ps(_mm256_permute_ps(A_23, 0x55), B_1, C_23);
+            C_01 = _mm256_fmadd_ps(_mm256_permute_ps(A_01, 0xaa), B_2, C_01);
+            C_23 = _mm256_fmadd_ps(_mm256_permute_ps(A_23, 0xaa), B_2, C_23);
+            C_01 = _mm256_fmadd_ps(_mm256_permute_ps(A_01, 0xff), B_3, C_01);
+            C_23 = _mm256_fmadd_ps(_mm256_permute_ps(A_23, 0xff), B_3, C_23);
+
+            number_products++;
+          }
+        }
+
+        _mm256_storeu_ps(&C_block[0], C_01);
+        _mm256_storeu_ps(&C_block[8], C_23);
+      }
+    }
+  }
+
+  /* Update flop count. */
+  *flop += 2.0*SPAMM_N_BLOCK*SPAMM_N_BLOCK*SPAMM_N_BLOCK*number_products;
+}
+#endif
+
+#ifdef HAVE_AVX512_KERNEL
+/** The stream kernel, using AVX-512.
+ *
+ * A C basic block fits into one 512-bit register, with one row per 128-bit
+ * lane. Row k of the B basic block is broadcast into all four lanes, and
+ * multiplied with column k of A splatted in place within the lanes of the A
+ * block, so that a basic block product takes 4 fused multiply-adds.
+ *
+ * @param number_stream_elements The size of the stream array.
+ * @param alpha The factor alpha
+ * @param tolerance The SpAMM tolerance.
+ * @param stream The stream index array.
+ * @param chunk_A The A matrix chunk.
+ * @param chunk_B The B matrix chunk.
+ * @param chunk_C The C matrix chunk.
+ * @param flop The flop count.
+ */
+__attribute__((target("avx512f")))
+void
+spamm_stream_kernel_AVX512 (const unsigned int number_stream_elements,
+    float alpha,
+    spamm_norm_t tolerance,
+    unsigned int *stream,
+    const void *const chunk_A,
+    const void *const chunk_B,
+    void *const chunk_C,
+    double *const flop)
+{
+  unsigned int i_stream, i_end, i_run;
+  unsigned int i, j, k;
+  unsigned int number_products = 0;
+
+  spamm_norm_t *norm_A;
+  spamm_norm_t *norm_B;
+
+  float *matrix_A;
+  float *matrix_B;
+  float *matrix_C;
+
+  float *A_block;
+  float *B_block;
+  float *C_block;
+
+  __m512 alpha_v;
+  __m512 A_v;
+  __m512 C_v;
+
+  norm_A = spamm_chunk_get_tier_norm(*spamm_chunk_get_number_tiers(chunk_A)-1, chunk_A);
+  norm_B = spamm_chunk_get_tier_norm(*spamm_chunk_get_number_tiers(chunk_B)-1, chunk_B);
+
+  matrix_A = spamm_chunk_get_matrix(chunk_A);
+  matrix_B = spamm_chunk_get_matrix(chunk_B);
+  matrix_C = spamm_chunk_get_matrix(chunk_C);
+
+  alpha_v = _mm512_set1_ps(alpha);
+
+  for(i_stream = 0; i_stream < number_stream_elements; i_stream = i_end)
+  {
+    i_end = spamm_kernel_stream_run_end(number_stream_elements, i_stream, stream);
+
+    for(i = 0; i < SPAMM_N_KERNEL_BLOCKED; i++) {
+      for(j = 0; j < SPAMM_N_KERNEL_BLOCKED; j++)
+      {
+        C_block = &matrix_C[stream[3*i_stream+2]*SPAMM_N_KERNEL*SPAMM_N_KERNEL
+          +(i*SPAMM_N_KERNEL_BLOCKED+j)*SPAMM_N_BLOCK*SPAMM_N_BLOCK];
+
+        C_v = _mm512_loadu_ps(C_block);
+
+        for(i_run = i_stream; i_run < i_end; i_run++) {
+          for(k = 0; k < SPAMM_N_KERNEL_BLOCKED; k++)
+          {
+            if(norm_A[stream[3*i_run+0]*SPAMM_N_KERNEL_BLOCKED*SPAMM_N_KERNEL_BLOCKED+i*SPAMM_N_KERNEL_BLOCKED+k]
+                *norm_B[stream[3*i_run+1]*SPAMM_N_KERNEL_BLOCKED*SPAMM_N_KERNEL_BLOCKED+k*SPAMM_N_KERNEL_BLOCKED+j]
+                <= tolerance) { continue; }
+
+            A_block = &matrix_A[stream[3*i_run+0]*SPAMM_N_KERNEL*SPAMM_N_KERNEL
+              +(i*SPAMM_N_KERNEL_BLOCKED+k)*SPAMM_N_BLOCK*SPAMM_N_BLOCK];
+            B_block = &matrix_B[stream[3*i_run+1]*SPAMM_N_KERNEL*SPAMM_N_KERNEL
+              +(k*SPAMM_N_KERNEL_BLOCKED+j)*SPAMM_N_BLOCK*SPAMM_N_BLOCK];
+
+            A_v = _mm512_mul_ps(alpha_v, _mm512_loadu_ps(A_block));
+
+            C_v = _mm512_fmadd_ps(_mm512_permute_ps(A_v, 0x00),
+                _mm512_broadcast_f32x4(_mm_loadu_ps(&B_block[0])), C_v);
+            C_v = _mm512_fmadd_ps(_mm512_permute_ps(A_v, 0x55),
+                _mm512_broadcast_f32x4(_mm_loadu_ps(&B_block[4])), C_v);
+            C_v = _mm512_fmadd_ps(_mm512_permute_ps(A_v, 0xaa),
+                _mm512_broadcast_f32x4(_mm_loadu_ps(&B_block[8])), C_v);
+            C_v = _mm512_fmadd_ps(_mm512_permute_ps(A_v, 0xff),
+                _mm512_broadcast_f32x4(_mm_loadu_ps(&B_block[12])), C_v);
+
+            number_products++;
+          }
+        }
+
+        _mm512_storeu_ps(C_block, C_v);
+      }
+    }
+  }
+
+  /* Update flop count. */
+  *flop += 2.0*SPAMM_N_BLOCK*SPAMM_N_BLOCK*SPAMM_N_BLOCK*number_products;
+}
+#endif
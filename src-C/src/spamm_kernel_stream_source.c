@@ -0,0 +1,107 @@
+/** @file
+ *
+ * The stream kernel in portable C for one element type, SPAMM_TYPE. This file
+ * is included by spamm_kernel_stream.c once for each type, with
+ * SPAMM_STREAM_KERNEL_MATRIX set to the matrix accessor of that type.
+ */
+
+/** The stream kernel, in portable C, for chunks of element type SPAMM_TYPE.
+ *
+ * @param number_stream_elements The size of the stream array.
+ * @param alpha The factor alpha
+ * @param tolerance The SpAMM tolerance.
+ * @param stream The stream index array.
+ * @param chunk_A The A matrix chunk.
+ * @param chunk_B The B matrix chunk.
+ * @param chunk_C The C matrix chunk.
+ * @param flop The flop count.
+ */
+void
+TYPED_FUNCTION(spamm_stream_kernel_C, SPAMM_TYPE) (const unsigned int number_stream_elements,
+    SPAMM_TYPE alpha,
+    spamm_norm_t tolerance,
+    unsigned int *stream,
+    const void *const chunk_A,
+    const void *const chunk_B,
+    void *const chunk_C,
+    double *const flop)
+{
+  unsigned int i_stream, i_end, i_run;
+  unsigned int i, j, k;
+  unsigned int i_block, j_block, k_block;
+  unsigned int norm_offset_A, norm_offset_B;
+  unsigned int offset_A, offset_B, offset_C;
+
+  spamm_norm_t *norm_A;
+  spamm_norm_t *norm_B;
+
+  SPAMM_TYPE *matrix_A;
+  SPAMM_TYPE *matrix_B;
+  SPAMM_TYPE *matrix_C;
+
+  SPAMM_TYPE C_block[SPAMM_N_BLOCK*SPAMM_N_BLOCK];
+
+  norm_A = spamm_chunk_get_tier_norm(*spamm_chunk_get_number_tiers(chunk_A)-1, chunk_A);
+  norm_B = spamm_chunk_get_tier_norm(*spamm_chunk_get_number_tiers(chunk_B)-1, chunk_B);
+
+  matrix_A = SPAMM_STREAM_KERNEL_MATRIX(chunk_A);
+  matrix_B = SPAMM_STREAM_KERNEL_MATRIX(chunk_B);
+  matrix_C = SPAMM_STREAM_KERNEL_MATRIX(chunk_C);
+
+  for(i_stream = 0; i_stream < number_stream_elements; i_stream = i_end)
+  {
+    i_end = spamm_kernel_stream_run_end(number_stream_elements, i_stream, stream);
+
+    for(i = 0; i < SPAMM_N_KERNEL_BLOCKED; i++) {
+      for(j = 0; j < SPAMM_N_KERNEL_BLOCKED; j++)
+      {
+        offset_C = stream[3*i_stream+2]*SPAMM_N_KERNEL*SPAMM_N_KERNEL
+          +(i*SPAMM_N_KERNEL_BLOCKED+j)*SPAMM_N_BLOCK*SPAMM_N_BLOCK;
+
+        /* Keep the C block local while the whole run is accumulated. */
+        for(i_block = 0; i_block < SPAMM_N_BLOCK*SPAMM_N_BLOCK; i_block++)
+        {
+          C_block[i_block] = matrix_C[offset_C+i_block];
+        }
+
+        for(i_run = i_stream; i_run < i_end; i_run++) {
+          for(k = 0; k < SPAMM_N_KERNEL_BLOCKED; k++)
+          {
+            norm_offset_A = stream[3*i_run+0]*SPAMM_N_KERNEL_BLOCKED*SPAMM_N_KERNEL_BLOCKED
+              +i*SPAMM_N_KERNEL_BLOCKED+k;
+            norm_offset_B = stream[3*i_run+1]*SPAMM_N_KERNEL_BLOCKED*SPAMM_N_KERNEL_BLOCKED
+              +k*SPAMM_N_KERNEL_BLOCKED+j;
+
+            if(norm_A[norm_offset_A]*norm_B[norm_offset_B] > tolerance)
+            {
+              offset_A = stream[3*i_run+0]*SPAMM_N_KERNEL*SPAMM_N_KERNEL
+                +(i*SPAMM_N_KERNEL_BLOCKED+k)*SPAMM_N_BLOCK*SPAMM_N_BLOCK;
+              offset_B = stream[3*i_run+1]*SPAMM_N_KERNEL*SPAMM_N_KERNEL
+                +(k*SPAMM_N_KERNEL_BLOCKED+j)*SPAMM_N_BLOCK*SPAMM_N_BLOCK;
+
+              for(i_block = 0; i_block < SPAMM_N_BLOCK; i_block++) {
+                for(j_block = 0; j_block < SPAMM_N_BLOCK; j_block++) {
+                  for(k_block = 0; k_block < SPAMM_N_BLOCK; k_block++)
+                  {
+                    C_block[i_block*SPAMM_N_BLOCK+j_block] +=
+                      alpha
+                      *matrix_A[offset_A+i_block*SPAMM_N_BLOCK+k_block]
+                      *matrix_B[offset_B+k_block*SPAMM_N_BLOCK+j_block];
+                  }
+                }
+              }
+
+              /* Update flop count. */
+              *flop += 2*SPAMM_N_BLOCK*SPAMM_N_BLOCK*SPAMM_N_BLOCK;
+            }
+          }
+        }
+
+        for(i_block = 0; i_block < SPAMM_N_BLOCK*SPAMM_N_BLOCK; i_block++)
+        {
+          matrix_C[offset_C+i_block] = C_block[i_block];
+        }
+      }
+    }
+  }
+}
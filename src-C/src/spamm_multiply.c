@@ -8,37 +8,16 @@
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #ifdef _OPENMP
 #include <omp.h>
 #endif
 
-#ifdef SPAMM_MULTIPLY_DEBUG
-#include <string.h>
-#endif
-
 #ifdef HAVE_SSE
 #include <xmmintrin.h>
 #endif
 
-/* Some commonly used bit-patterns are:
- *
- * For 3D indices:
- *
- * 010010010010010010010010010010 = 0x12492492
- * 101101101101101101101101101101 = 0x2DB6DB6D
- *
- * For 2D indices:
- * 01010101010101010101010101010101 = 0x55555555
- * 10101010101010101010101010101010 = 0xaaaaaaaa
- */
-
-/** 01010101010101010101010101010101 = 0x55555555 */
-#define MASK_2D_J  0x55555555
-
-/** 10101010101010101010101010101010 = 0xaaaaaaaa */
-#define MASK_2D_I  0xaaaaaaaa
-
 /** @private k lookup table to speed up loop over indices. */
 struct spamm_multiply_k_lookup_t
 {
@@ -60,83 +39,19 @@ struct spamm_multiply_k_lookup_t
  * @return The new squared norm.
  */
 spamm_norm_t
-spamm_chunk_multiply_scalar (const float alpha,
+spamm_chunk_multiply_scalar (const double alpha,
     spamm_chunk_t *chunk,
     double *const flop,
     double *const mop)
 {
-  unsigned int i;
-  unsigned int number_norms;
-  unsigned int number_tiers;
-  unsigned int N_contiguous;
-  unsigned int number_dimensions;
-
-  float *A;
-  float *A_dilated;
-
-  float alpha2;
-
-  assert(flop != NULL);
-  assert(mop != NULL);
-
-  spamm_norm_t *norm;
-  spamm_norm_t *norm2;
-
   if(chunk == NULL) { return 0.0; }
 
-  number_dimensions = *spamm_chunk_get_number_dimensions(chunk);
-  number_tiers = *spamm_chunk_get_number_tiers(chunk);
-  N_contiguous = spamm_chunk_get_N_contiguous(chunk);
-  A = spamm_chunk_get_matrix(chunk);
-  A_dilated = spamm_chunk_get_matrix_dilated(chunk);
-
-  if(alpha == 0.0)
-  {
-    for(i = 0; i < ipow(N_contiguous, number_dimensions); i++)
-    {
-      A[i] = 0.0;
-
-      A_dilated[4*i+0] = 0.0;
-      A_dilated[4*i+1] = 0.0;
-      A_dilated[4*i+2] = 0.0;
-      A_dilated[4*i+3] = 0.0;
-    }
-  }
-
-  else
-  {
-    if(alpha != 1.0)
-    {
-      for(i = 0; i < ipow(N_contiguous, number_dimensions); i++)
-      {
-        A[i] *= alpha;
-
-        A_dilated[4*i+0] = A[i];
-        A_dilated[4*i+1] = A[i];
-        A_dilated[4*i+2] = A[i];
-        A_dilated[4*i+3] = A[i];
-      }
-
-      /* Update the flop count. */
-      *flop += ipow(N_contiguous, number_dimensions);
-      *mop += 4*ipow(N_contiguous, number_dimensions);
-    }
-  }
-
-  norm = spamm_chunk_get_norm(chunk);
-  norm2 = spamm_chunk_get_norm2(chunk);
-  number_norms = spamm_chunk_get_total_number_norms(number_tiers, number_dimensions);
-  alpha2 = alpha*alpha;
-  for(i = 0; i < number_norms; i++)
+  if(*spamm_chunk_get_precision(chunk) == double_precision)
   {
-    norm2[i] *= alpha2;
-    norm[i] = sqrt(norm2[i]);
+    return spamm_chunk_multiply_scalar_double(alpha, chunk, flop, mop);
   }
 
-  /* Update flop count for updating norms. */
-  //*flop += 2*number_norms;
-
-  return norm2[0];
+  return spamm_chunk_multiply_scalar_float(alpha, chunk, flop, mop);
 }
 
 /** @private Multiply a matrix by a scalar.
@@ -145,7 +60,7 @@ spamm_chunk_multiply_scalar (const float alpha,
  * @param A The matrix.
  */
 void
-spamm_recursive_multiply_scalar (const float alpha,
+spamm_recursive_multiply_scalar (const double alpha,
     struct spamm_recursive_node_t *A,
     const unsigned int number_dimensions,
     const unsigned int tier,
@@ -171,14 +86,352 @@ spamm_recursive_multiply_scalar (const float alpha,
   {
     if(A->tree.child != NULL)
     {
-      for(i = 0; i < ipow(2, number_dimensions); i++)
+      for(i = 0, A->norm2 = 0; i < ipow(2, number_dimensions); i++)
       {
         spamm_recursive_multiply_scalar(alpha, A->tree.child[i],
             number_dimensions, tier+1, chunk_tier, use_linear_tree, flop,
             mop);
+
+        if(A->tree.child[i] != NULL)
+        {
+          A->norm2 += A->tree.child[i]->norm2;
+        }
       }
+      A->norm = sqrt(A->norm2);
+    }
+  }
+}
+
+/** @private Bucket a multiply stream by its C index.
+ *
+ * The stream is reordered (stably) such that all products accumulating into
+ * the same C kernel block are contiguous. Each bucket can then be run back to
+ * back with its C block kept in cache, and is owned by exactly one thread.
+ *
+ * @param stream_length The number of stream elements.
+ * @param number_buckets The number of C blocks, i.e. the range of the C
+ * index.
+ * @param stream The stream of {A, B, C} index triples.
+ * @param work Work space of stream_length triples.
+ * @param bucket_offset [out] The offsets of the buckets in the sorted stream,
+ * an array of number_buckets+1 elements. Bucket i covers stream elements
+ * bucket_offset[i] to bucket_offset[i+1]-1.
+ */
+void
+spamm_multiply_bucket_stream (const unsigned int stream_length,
+    const unsigned int number_buckets,
+    unsigned int *const stream,
+    unsigned int *const work,
+    unsigned int *const bucket_offset)
+{
+  unsigned int i;
+  unsigned int bucket;
+
+  for(i = 0; i <= number_buckets; i++)
+  {
+    bucket_offset[i] = 0;
+  }
+
+  if(stream_length == 0) { return; }
+
+  /* Count and scan. */
+  for(i = 0; i < stream_length; i++)
+  {
+    bucket_offset[stream[3*i+2]+1]++;
+  }
+
+  for(i = 0; i < number_buckets; i++)
+  {
+    bucket_offset[i+1] += bucket_offset[i];
+  }
+
+  /* Scatter, using bucket_offset[bucket] as the running insert position. */
+  for(i = 0; i < stream_length; i++)
+  {
+    bucket = stream[3*i+2];
+    work[3*bucket_offset[bucket]+0] = stream[3*i+0];
+    work[3*bucket_offset[bucket]+1] = stream[3*i+1];
+    work[3*bucket_offset[bucket]+2] = stream[3*i+2];
+    bucket_offset[bucket]++;
+  }
+
+  /* The insert positions are now the bucket ends, shift them back. */
+  for(i = number_buckets; i > 0; i--)
+  {
+    bucket_offset[i] = bucket_offset[i-1];
+  }
+  bucket_offset[0] = 0;
+
+  memcpy(stream, work, stream_length*3*sizeof(unsigned int));
+}
+
+/** @private Allocate the per-thread scratch space of a multiply.
+ *
+ * @param index_length The number of kernel blocks along one side of a chunk.
+ *
+ * @return The scratch space.
+ */
+static struct spamm_multiply_scratch_t *
+spamm_multiply_scratch_new (const unsigned int index_length)
+{
+  struct spamm_multiply_scratch_t *scratch;
+
+  scratch = malloc(sizeof(struct spamm_multiply_scratch_t));
+  scratch->index_length = index_length;
+#ifdef _OPENMP
+  scratch->number_threads = omp_get_max_threads();
+#else
+  scratch->number_threads = 1;
+#endif
+  scratch->buffer = calloc(scratch->number_threads, sizeof(unsigned int*));
+  scratch->in_use = calloc(scratch->number_threads, sizeof(int));
+
+  return scratch;
+}
+
+/** @private Get the size of a scratch buffer.
+ *
+ * @param index_length The number of kernel blocks along one side of a chunk.
+ *
+ * @return The number of elements in the buffer.
+ */
+static inline size_t
+spamm_multiply_scratch_size (const unsigned int index_length)
+{
+  /* Stream, bucket work space, and bucket offsets. */
+  return 2*3*ipow(index_length, 3)+ipow(index_length, 2)+1;
+}
+
+/** @private Get the scratch buffer of the calling thread.
+ *
+ * The buffer is allocated on first use, by the thread which will use it. If
+ * the buffer of the thread is still held by a suspended linear multiply, a
+ * temporary buffer is allocated instead.
+ *
+ * @param scratch The scratch space.
+ * @param owner [out] The thread owning the buffer, or -1 for a temporary
+ * buffer.
+ *
+ * @return The buffer.
+ */
+static unsigned int *
+spamm_multiply_scratch_get (struct spamm_multiply_scratch_t *const scratch,
+    int *const owner)
+{
+  int thread = 0;
+  int in_use;
+  unsigned int *buffer;
+
+#ifdef _OPENMP
+  thread = omp_get_thread_num();
+#endif
+
+  assert(thread < scratch->number_threads);
+
+#pragma omp atomic read
+  in_use = scratch->in_use[thread];
+
+  if(in_use)
+  {
+    if((buffer = malloc(spamm_multiply_scratch_size(scratch->index_length)*sizeof(unsigned int))) == NULL)
+    {
+      SPAMM_FATAL("can not allocate stream\n");
+    }
+
+    *owner = -1;
+    return buffer;
+  }
+
+#pragma omp atomic write
+  scratch->in_use[thread] = 1;
+
+  if(scratch->buffer[thread] == NULL)
+  {
+    if((scratch->buffer[thread] = malloc(spamm_multiply_scratch_size(scratch->index_length)*sizeof(unsigned int))) == NULL)
+    {
+      SPAMM_FATAL("can not allocate stream\n");
+    }
+  }
+
+  *owner = thread;
+  return scratch->buffer[thread];
+}
+
+/** @private Release a scratch buffer obtained with
+ * spamm_multiply_scratch_get().
+ *
+ * An untied task may release the buffer on a different thread than it got it
+ * on, hence the owner is passed back explicitly.
+ *
+ * @param scratch The scratch space.
+ * @param owner The thread owning the buffer, or -1 for a temporary buffer.
+ * @param buffer The buffer.
+ */
+static void
+spamm_multiply_scratch_release (struct spamm_multiply_scratch_t *const scratch,
+    const int owner,
+    unsigned int *const buffer)
+{
+  if(owner < 0)
+  {
+    free(buffer);
+    return;
+  }
+
+#pragma omp atomic write
+  scratch->in_use[owner] = 0;
+}
+
+/** @private Free the scratch space of a multiply.
+ *
+ * @param scratch The scratch space.
+ */
+static void
+spamm_multiply_scratch_delete (struct spamm_multiply_scratch_t **const scratch)
+{
+  int thread;
+
+  if(*scratch == NULL) { return; }
+
+  for(thread = 0; thread < (*scratch)->number_threads; thread++)
+  {
+    free((*scratch)->buffer[thread]);
+  }
+  free((*scratch)->buffer);
+  free((*scratch)->in_use);
+  free(*scratch);
+  *scratch = NULL;
+}
+
+/** @private The smallest number of kernel block products worth running in a
+ * task of their own, see spamm_linear_multiply_stream(). */
+#define SPAMM_LINEAR_MULTIPLY_TASK_SIZE 32
+
+/** @private Run a part of a bucketed stream with the stream kernel of the
+ * chunk precision.
+ *
+ * @param kernel The single precision stream kernel.
+ * @param stream_length The number of stream elements.
+ * @param alpha The factor alpha.
+ * @param tolerance The SpAMM tolerance.
+ * @param stream The stream.
+ * @param chunk_A The A matrix chunk.
+ * @param chunk_B The B matrix chunk.
+ * @param chunk_C The C matrix chunk.
+ * @param flop The flop count.
+ */
+static void
+spamm_linear_multiply_kernel (const enum spamm_kernel_t kernel,
+    const unsigned int stream_length,
+    const double alpha,
+    const spamm_norm_t tolerance,
+    unsigned int *const stream,
+    const spamm_chunk_t *const chunk_A,
+    const spamm_chunk_t *const chunk_B,
+    spamm_chunk_t *const chunk_C,
+    double *const flop)
+{
+  /* Only the C kernel is generated for double precision chunks. */
+  if(*spamm_chunk_get_precision(chunk_C) == double_precision)
+  {
+    spamm_stream_kernel_C_double(stream_length, alpha, tolerance, stream,
+        chunk_A, chunk_B, chunk_C, flop);
+  }
+
+  else
+  {
+    spamm_kernel_stream_run(kernel, stream_length, alpha, tolerance, stream,
+        chunk_A, chunk_B, chunk_C, flop);
+  }
+}
+
+/** @private Run a bucketed stream, in parallel across the team.
+ *
+ * The buckets are split into contiguous ranges holding about equal numbers of
+ * products, and each range is run as a task. A C kernel block is in exactly
+ * one bucket, so the tasks write disjoint parts of chunk_C and need neither
+ * locks nor atomics. Short streams, streams outside of a parallel region,
+ * and streams of a product that holds the lock of its C node, are run in the
+ * calling task.
+ *
+ * @param stream_length The number of stream elements.
+ * @param number_buckets The number of buckets.
+ * @param bucket_offset The bucket offsets from
+ * spamm_multiply_bucket_stream().
+ * @param alpha The factor alpha.
+ * @param tolerance The SpAMM tolerance.
+ * @param stream The bucketed stream.
+ * @param chunk_A The A matrix chunk.
+ * @param chunk_B The B matrix chunk.
+ * @param chunk_C The C matrix chunk.
+ * @param flop The flop count.
+ */
+static void
+spamm_linear_multiply_stream (const unsigned int stream_length,
+    const unsigned int number_buckets,
+    const unsigned int *const bucket_offset,
+    const double alpha,
+    const spamm_norm_t tolerance,
+    unsigned int *const stream,
+    const spamm_chunk_t *const chunk_A,
+    const spamm_chunk_t *const chunk_B,
+    spamm_chunk_t *const chunk_C,
+    double *const flop)
+{
+  enum spamm_kernel_t kernel;
+
+  unsigned int number_tasks = 1;
+  unsigned int task;
+  unsigned int bucket_begin, bucket_end;
+
+  kernel = spamm_kernel_select();
+
+  /* With node locks the caller holds the lock of node_C. A thread waiting
+   * in the taskwait below may then be handed another task which blocks on
+   * that same lock, so the stream is only split with owner computes
+   * scheduling, which takes no locks. */
+#if defined(_OPENMP) && !defined(SPAMM_NODE_LOCK)
+  number_tasks = omp_get_num_threads();
+#endif
+
+  if(number_tasks > stream_length/SPAMM_LINEAR_MULTIPLY_TASK_SIZE)
+  {
+    number_tasks = stream_length/SPAMM_LINEAR_MULTIPLY_TASK_SIZE;
+  }
+
+  if(number_tasks < 2)
+  {
+    spamm_linear_multiply_kernel(kernel, stream_length, alpha, tolerance,
+        stream, chunk_A, chunk_B, chunk_C, flop);
+    return;
+  }
+
+  for(task = 0, bucket_begin = 0; task < number_tasks; task++, bucket_begin = bucket_end)
+  {
+    /* End the range at the first bucket boundary past its share of the
+     * stream. */
+    for(bucket_end = bucket_begin; bucket_end < number_buckets
+        && bucket_offset[bucket_end] < ((task+1)*(unsigned long) stream_length)/number_tasks;
+        bucket_end++) {}
+
+    if(task == number_tasks-1) { bucket_end = number_buckets; }
+
+    if(bucket_offset[bucket_end] == bucket_offset[bucket_begin]) { continue; }
+
+#pragma omp task untied
+    {
+      double task_flop = 0;
+
+      spamm_linear_multiply_kernel(kernel,
+          bucket_offset[bucket_end]-bucket_offset[bucket_begin], alpha,
+          tolerance, &stream[3*bucket_offset[bucket_begin]], chunk_A, chunk_B,
+          chunk_C, &task_flop);
+
+#pragma omp atomic
+      *flop += task_flop;
     }
   }
+#pragma omp taskwait
 }
 
 /** Multiply two matrices, i.e. \f$ C = \alpha A \times B + \beta C\f$.
@@ -189,6 +442,8 @@ spamm_recursive_multiply_scalar (const float alpha,
  * @param B The matrix \f$B\f$.
  * @param beta The paramater \f$\beta\f$.
  * @param C The matrix \f$C\f$.
+ * @param scratch The per-thread scratch space of this multiply, or NULL to
+ * allocate the stream here.
  * @param flop Number of floating point operations.
  * @param mop The memory operation count
  *
@@ -196,20 +451,26 @@ spamm_recursive_multiply_scalar (const float alpha,
  */
 spamm_norm_t
 spamm_linear_multiply (const spamm_norm_t tolerance,
-    const float alpha,
+    const double alpha,
     const spamm_chunk_t *const chunk_A,
     const spamm_chunk_t *const chunk_B,
     spamm_chunk_t *const chunk_C,
+    struct spamm_multiply_scratch_t *const scratch,
     double *const flop,
     double *const mop)
 {
   unsigned int *index_A;
   unsigned int *index_B;
 
+  unsigned int *buffer;
   unsigned int *stream;
+  unsigned int *work;
+  unsigned int *bucket_offset;
+  int owner;
 
   unsigned int N_contiguous;
   unsigned int index_length;
+  unsigned int number_buckets;
 
   unsigned int i;
   unsigned int j_A, j_B;
@@ -225,58 +486,37 @@ spamm_linear_multiply (const spamm_norm_t tolerance,
 
   spamm_norm_t norm2_result;
 
-#if !defined(RUN_ASSEMBLY_KERNEL)
-  float *matrix_A;
-  float *matrix_B;
-  float *matrix_C;
-
-  unsigned int i_stream;
-  unsigned int j, k;
-  unsigned int i_block, j_block, k_block;
-  unsigned int norm_offset_A, norm_offset_B, norm_offset_C;
-  unsigned int offset_A, offset_B, offset_C;
-#endif
-
   N_contiguous = spamm_chunk_get_N_contiguous(chunk_A);
   index_length = N_contiguous/SPAMM_N_KERNEL;
 
-  index_A = malloc(ipow(index_length, 2)*sizeof(unsigned int));
-  index_B = malloc(ipow(index_length, 2)*sizeof(unsigned int));
-
-  for(i = 0; i < ipow(index_length, 2); i++)
-  {
-    index_A[i] = i;
-    index_B[i] = i;
-  }
+  /* The indices, sorted along the k index and by descending norm within
+   * each k-block, are kept up to date in the chunks by spamm_chunk_fix(). */
+  index_A = spamm_chunk_get_sorted_index_A(chunk_A);
+  index_B = spamm_chunk_get_sorted_index_B(chunk_B);
 
-  /* Sort indices along k index. */
-  spamm_sort_masked(ipow(index_length, 2), index_A, MASK_2D_J);
-  spamm_sort_masked(ipow(index_length, 2), index_B, MASK_2D_I);
-
-  /* Sort within each k-block by descending norm. */
   norm_A = spamm_chunk_get_tier_norm(*spamm_chunk_get_number_tiers(chunk_A)-SPAMM_KERNEL_DEPTH-1, chunk_A);
   norm_B = spamm_chunk_get_tier_norm(*spamm_chunk_get_number_tiers(chunk_B)-SPAMM_KERNEL_DEPTH-1, chunk_B);
 
-  for(i = 0; i < index_length; i++)
+  if(scratch != NULL)
   {
-    spamm_sort_norm(index_length, &index_A[i*index_length], norm_A);
-    spamm_sort_norm(index_length, &index_B[i*index_length], norm_B);
+    assert(scratch->index_length == index_length);
+    buffer = spamm_multiply_scratch_get(scratch, &owner);
   }
 
-#ifdef SPAMM_MULTIPLY_DEBUG
-  SPAMM_INFO("potentially %u product(s)\n", ipow(index_length, 3));
-#endif
-
-  /* Convolute. */
-  if((stream = malloc(ipow(index_length, 3)*3*sizeof(unsigned int))) == NULL)
+  else if((buffer = malloc(spamm_multiply_scratch_size(index_length)*sizeof(unsigned int))) == NULL)
   {
     SPAMM_FATAL("can not allocate stream\n");
   }
 
+  stream = buffer;
+  work = &buffer[3*ipow(index_length, 3)];
+  bucket_offset = &buffer[2*3*ipow(index_length, 3)];
+
 #ifdef SPAMM_MULTIPLY_DEBUG
-  SPAMM_INFO("allocated stream (%p) with %i triple elements\n", stream, ipow(index_length, 3));
+  SPAMM_INFO("potentially %u product(s)\n", ipow(index_length, 3));
 #endif
 
+  /* Convolute. */
   for(i = 0, stream_index = 0; i < index_length; i++)
   {
     for(j_A = i*index_length; j_A < (i+1)*index_length; j_A++) {
@@ -319,9 +559,11 @@ spamm_linear_multiply (const spamm_norm_t tolerance,
     }
   }
 
-  /* Free memory. */
-  free(index_A);
-  free(index_B);
+  /* Bucket the stream by C block, so that all products into one C block are
+   * run back to back. */
+  number_buckets = ipow(index_length, 2);
+  spamm_multiply_bucket_stream(stream_index, number_buckets, stream, work,
+      bucket_offset);
 
 #ifdef SPAMM_MULTIPLY_DEBUG
   SPAMM_INFO("Added %u (out of %u possible) block products to stream\n", stream_index, ipow(index_length, 3));
@@ -334,97 +576,22 @@ spamm_linear_multiply (const spamm_norm_t tolerance,
   SPAMM_INFO("C: "); spamm_print_chunk(chunk_C);
 #endif
 
-#ifdef RUN_ASSEMBLY_KERNEL
-  spamm_stream_kernel(stream_index, alpha, tolerance, stream, chunk_A, chunk_B, chunk_C);
-#else
-  norm_A = spamm_chunk_get_tier_norm(*spamm_chunk_get_number_tiers(chunk_A)-1, chunk_A);
-  norm_B = spamm_chunk_get_tier_norm(*spamm_chunk_get_number_tiers(chunk_B)-1, chunk_B);
-
-  matrix_A = spamm_chunk_get_matrix(chunk_A);
-  matrix_B = spamm_chunk_get_matrix(chunk_B);
-  matrix_C = spamm_chunk_get_matrix(chunk_C);
+  spamm_linear_multiply_stream(stream_index, number_buckets, bucket_offset,
+      alpha, tolerance, stream, chunk_A, chunk_B, chunk_C, flop);
 
-#ifdef SPAMM_MULTIPLY_DEBUG
-  SPAMM_INFO("starting to calculate product\n");
-  fflush(stdout);
-#endif
-  for(i_stream = 0; i_stream < stream_index; i_stream++)
+  /* Free memory. */
+  if(scratch != NULL)
   {
-#ifdef SPAMM_MULTIPLY_DEBUG
-    SPAMM_INFO("lin.index (%u,%u,%u)\n", stream[3*i_stream+0], stream[3*i_stream+1], stream[3*i_stream+2]);
-#endif
-
-    for(i = 0; i < SPAMM_N_KERNEL_BLOCKED; i++) {
-      for(j = 0; j < SPAMM_N_KERNEL_BLOCKED; j++) {
-        for(k = 0; k < SPAMM_N_KERNEL_BLOCKED; k++)
-        {
-          norm_offset_A = stream[3*i_stream+0]*SPAMM_N_KERNEL_BLOCKED*SPAMM_N_KERNEL_BLOCKED
-            +i*SPAMM_N_KERNEL_BLOCKED+k;
-          norm_offset_B = stream[3*i_stream+1]*SPAMM_N_KERNEL_BLOCKED*SPAMM_N_KERNEL_BLOCKED
-            +k*SPAMM_N_KERNEL_BLOCKED+j;
-          norm_offset_C = stream[3*i_stream+2]*SPAMM_N_KERNEL_BLOCKED*SPAMM_N_KERNEL_BLOCKED
-            +i*SPAMM_N_KERNEL_BLOCKED+j;
-
-          offset_A = stream[3*i_stream+0]*SPAMM_N_KERNEL*SPAMM_N_KERNEL
-            +(i*SPAMM_N_KERNEL_BLOCKED+k)*SPAMM_N_BLOCK*SPAMM_N_BLOCK;
-          offset_B = stream[3*i_stream+1]*SPAMM_N_KERNEL*SPAMM_N_KERNEL
-            +(k*SPAMM_N_KERNEL_BLOCKED+j)*SPAMM_N_BLOCK*SPAMM_N_BLOCK;
-          offset_C = stream[3*i_stream+2]*SPAMM_N_KERNEL*SPAMM_N_KERNEL
-            +(i*SPAMM_N_KERNEL_BLOCKED+j)*SPAMM_N_BLOCK*SPAMM_N_BLOCK;
-
-#ifdef SPAMM_MULTIPLY_DEBUG
-          SPAMM_INFO("(i = %u, j = %u, k = %u) -> norm_A = %e, norm_B = %e, "
-              "norm_offset_C = %u, offset_A = %u, offset_B = %u, "
-              "offset_C = %u\n", i, j, k, norm_A[norm_offset_A],
-              norm_B[norm_offset_B], norm_offset_C, offset_A, offset_B,
-              offset_C);
-#endif
-
-          if(norm_A[norm_offset_A]*norm_B[norm_offset_B] > tolerance)
-          {
-#ifdef SPAMM_MULTIPLY_DEBUG
-            SPAMM_INFO("multiplying %ux%u block\n", SPAMM_N_BLOCK, SPAMM_N_BLOCK);
-#endif
-            for(i_block = 0; i_block < SPAMM_N_BLOCK; i_block++) {
-              for(j_block = 0; j_block < SPAMM_N_BLOCK; j_block++) {
-                for(k_block = 0; k_block < SPAMM_N_BLOCK; k_block++)
-                {
-                  SPAMM_INFO("matrix_C[%u] = %e\n",
-                      offset_C+i_block*SPAMM_N_BLOCK+j_block,
-                      matrix_C[offset_C+i_block*SPAMM_N_BLOCK+j_block]);
-
-                  matrix_C[offset_C+i_block*SPAMM_N_BLOCK+j_block] +=
-                    alpha
-                    *matrix_A[offset_A+i_block*SPAMM_N_BLOCK+k_block]
-                    *matrix_B[offset_B+k_block*SPAMM_N_BLOCK+j_block];
-
-                  SPAMM_INFO("matrix_C[%u] = %e\n",
-                      offset_C+i_block*SPAMM_N_BLOCK+j_block,
-                      matrix_C[offset_C+i_block*SPAMM_N_BLOCK+j_block]);
-
-                }
-
-#ifdef SPAMM_MULTIPLY_DEBUG
-                SPAMM_INFO("(i_block = %u, j_block = %u) -> row_maj = %u\n", i_block, j_block, i_block*SPAMM_N_BLOCK+j_block);
-                fflush(stdout);
-#endif
-              }
-            }
-
-            /* Update flop count. */
-            *flop += 2*SPAMM_N_BLOCK*SPAMM_N_BLOCK*SPAMM_N_BLOCK;
-          }
-        }
-      }
-    }
+    spamm_multiply_scratch_release(scratch, owner, buffer);
   }
-#endif
 
-  /* Free memory. */
+  else
+  {
 #ifdef SPAMM_MULTIPLY_DEBUG
-  SPAMM_INFO("freeing stream = %p\n", stream);
+    SPAMM_INFO("freeing stream = %p\n", stream);
 #endif
-  free(stream);
+    free(buffer);
+  }
 
   if(stream_index > 0)
   {
@@ -452,7 +619,8 @@ spamm_linear_multiply (const spamm_norm_t tolerance,
  * @param chunk_A Chunk A.
  * @param chunk_B Chunk B.
  * @param chunk_C Chunk C.
- * @param sgemm The sgemm() function to call.
+ * @param sgemm The sgemm() function to call. Double precision chunks are
+ * multiplied with dgemm() if it is set, see spamm_chunk_multiply_double().
  * @param flop The flop count.
  * @param mop The memory operation count
  *
@@ -460,7 +628,7 @@ spamm_linear_multiply (const spamm_norm_t tolerance,
  */
 spamm_norm_t
 spamm_chunk_multiply (const spamm_norm_t tolerance,
-    const float alpha,
+    const double alpha,
     const spamm_chunk_t *const chunk_A,
     const spamm_chunk_t *const chunk_B,
     spamm_chunk_t *const chunk_C,
@@ -468,75 +636,37 @@ spamm_chunk_multiply (const spamm_norm_t tolerance,
     double *const flop,
     double *const mop)
 {
-  unsigned int i, j, k;
-
-  spamm_norm_t *norm_A;
-  spamm_norm_t *norm_B;
-
-  spamm_norm_t *norm2_C;
-
-  float alpha_sgemm = alpha;
-  float beta = 1.0;
-
-  int N_contiguous;
-
-  float *matrix_A;
-  float *matrix_B;
-  float *matrix_C;
-
   assert(chunk_C != NULL);
-  assert(flop != NULL);
-  assert(mop != NULL);
-
-  if(chunk_A == NULL || chunk_B == NULL) { return 0.0; }
-
-  norm_A = spamm_chunk_get_norm(chunk_A);
-  norm_B = spamm_chunk_get_norm(chunk_B);
 
-  if(norm_A[0]*norm_B[0] > tolerance)
+  if(*spamm_chunk_get_precision(chunk_C) == double_precision)
   {
-    matrix_A = spamm_chunk_get_matrix(chunk_A);
-    matrix_B = spamm_chunk_get_matrix(chunk_B);
-    matrix_C = spamm_chunk_get_matrix(chunk_C);
-
-    N_contiguous = spamm_chunk_get_N_contiguous(chunk_A);
-
-    if(sgemm)
-    {
-      sgemm("N", "N", &N_contiguous, &N_contiguous, &N_contiguous,
-          &alpha_sgemm, matrix_A, &N_contiguous, matrix_B, &N_contiguous,
-          &beta, matrix_C, &N_contiguous);
-    }
-
-    else
-    {
-      /* Braindead multiply in nested loops. */
-      for(i = 0; i < N_contiguous; i++) {
-        for(j = 0; j < N_contiguous; j++) {
-          for(k = 0; k < N_contiguous; k++)
-          {
-            matrix_C[spamm_index_column_major(i, j, N_contiguous, N_contiguous)] += alpha
-              *matrix_A[spamm_index_column_major(i, k, N_contiguous, N_contiguous)]
-              *matrix_B[spamm_index_column_major(k, j, N_contiguous, N_contiguous)];
-          }
-        }
-      }
-    }
-
-    /* Update flop count. */
-    *flop += 2*N_contiguous*N_contiguous*N_contiguous;
-
-    /* Fix up norms. */
-    return spamm_chunk_fix(chunk_C, flop, mop);
+    return spamm_chunk_multiply_double(tolerance, alpha, chunk_A, chunk_B,
+        chunk_C, sgemm, flop, mop);
   }
 
-  else
-  {
-    norm2_C = spamm_chunk_get_norm2(chunk_C);
-    return norm2_C[0];
-  }
+  return spamm_chunk_multiply_float(tolerance, alpha, chunk_A, chunk_B,
+      chunk_C, sgemm, flop, mop);
 }
 
+#ifdef SPAMM_MULTIPLY_OWNER_COMPUTES
+/** @private Check whether the product of two nodes is above the SpAMM
+ * tolerance.
+ *
+ * @param tolerance The SpAMM tolerance.
+ * @param node_A Node A, or NULL.
+ * @param node_B Node B, or NULL.
+ *
+ * @return Whether the product has to be computed.
+ */
+static inline short
+spamm_recursive_multiply_is_above_tolerance (const spamm_norm_t tolerance,
+    const struct spamm_recursive_node_t *const node_A,
+    const struct spamm_recursive_node_t *const node_B)
+{
+  return (node_A != NULL && node_B != NULL && node_A->norm*node_B->norm > tolerance);
+}
+#endif
+
 /** Multiply two matrices, i.e. \f$ C = \alpha A \times B + \beta C\f$.
  *
  * @param tolerance The SpAMM tolerance of this product.
@@ -550,12 +680,13 @@ spamm_chunk_multiply (const spamm_norm_t tolerance,
  * @param chunk_tier The contiguous tier.
  * @param use_linear_tree If set to 1 then we will switch to a linear tree at
  * chunk_tier.
+ * @param scratch The per-thread scratch space of the linear multiply.
  * @param flop The number of floating point operations.
  * @param mop The memory operation count
  */
 void
 spamm_recursive_multiply (const spamm_norm_t tolerance,
-    const float alpha,
+    const double alpha,
     struct spamm_recursive_node_t *node_A,
     struct spamm_recursive_node_t *node_B,
     struct spamm_recursive_node_t *node_C,
@@ -569,11 +700,10 @@ spamm_recursive_multiply (const spamm_norm_t tolerance,
     const unsigned int tier,
     const unsigned int chunk_tier,
     const short use_linear_tree,
+    struct spamm_multiply_scratch_t *const scratch,
     double *const flop,
     double *const mop)
 {
-  unsigned int *new_N_lower = NULL;
-  unsigned int *new_N_upper = NULL;
 
   short i, j, k;
 
@@ -607,39 +737,52 @@ spamm_recursive_multiply (const spamm_norm_t tolerance,
 
   if(tier == chunk_tier)
   {
+    /* Products into different C chunks run concurrently, so the counts are
+     * summed locally and added atomically. */
+    double chunk_flop = 0;
+    double chunk_mop = 0;
+
     if(node_A->tree.chunk == NULL || node_B->tree.chunk == NULL)
     {
       return;
     }
 
-#ifdef _OPENMP
+#ifdef SPAMM_NODE_LOCK
     omp_set_lock(&node_C->lock);
 #endif
 
     if(node_C->tree.chunk == NULL)
     {
-      node_C->tree.chunk = spamm_new_chunk(number_dimensions_C, use_linear_tree, N, N_lower, N_upper);
+      node_C->tree.chunk = spamm_new_chunk_precision(number_dimensions_C,
+          use_linear_tree, *spamm_chunk_get_precision(node_A->tree.chunk), N,
+          N_lower, N_upper);
     }
 
     if(use_linear_tree)
     {
       node_C->norm2 = spamm_linear_multiply(tolerance, alpha,
-          node_A->tree.chunk, node_B->tree.chunk, node_C->tree.chunk, flop,
-          mop);
+          node_A->tree.chunk, node_B->tree.chunk, node_C->tree.chunk,
+          scratch, &chunk_flop, &chunk_mop);
     }
 
     else
     {
       node_C->norm2 = spamm_chunk_multiply(tolerance, alpha,
           node_A->tree.chunk, node_B->tree.chunk, node_C->tree.chunk, sgemm,
-          flop, mop);
+          &chunk_flop, &chunk_mop);
     }
 
     node_C->norm = sqrt(node_C->norm2);
 
-#ifdef _OPENMP
+#ifdef SPAMM_NODE_LOCK
     omp_unset_lock(&node_C->lock);
 #endif
+
+#pragma omp atomic
+    *flop += chunk_flop;
+
+#pragma omp atomic
+    *mop += chunk_mop;
   }
 
   else
@@ -653,6 +796,62 @@ spamm_recursive_multiply (const spamm_norm_t tolerance,
        number_dimensions_B == 2 &&
        number_dimensions_C == 2)
     {
+#ifdef SPAMM_MULTIPLY_OWNER_COMPUTES
+      /* Owner computes: one task per C child, which runs the products over k
+       * one after the other. Every C node is therefore written by exactly one
+       * task, and the C children are created here, before the tasks are
+       * spawned, so no locks are needed. */
+      for(i = 0; i < 2; i++) {
+        for(j = 0; j < 2; j++)
+        {
+          if(!spamm_recursive_multiply_is_above_tolerance(tolerance, node_A->tree.child[i], node_B->tree.child[2*j])
+              && !spamm_recursive_multiply_is_above_tolerance(tolerance, node_A->tree.child[i+2], node_B->tree.child[1+2*j]))
+          {
+            continue;
+          }
+
+          if(node_C->tree.child == NULL)
+          {
+            node_C->tree.child = calloc(ipow(2, number_dimensions_C), sizeof(struct spamm_recursive_node_t*));
+          }
+
+          if(node_C->tree.child[i+2*j] == NULL)
+          {
+            node_C->tree.child[i+2*j] = spamm_recursive_new_node();
+          }
+
+#pragma omp task untied
+          {
+            unsigned int new_N_lower[SPAMM_MAX_NUMBER_DIMENSIONS];
+            unsigned int new_N_upper[SPAMM_MAX_NUMBER_DIMENSIONS];
+
+            new_N_lower[0] = N_lower[0]+(N_upper[0]-N_lower[0])/2*i;
+            new_N_upper[0] = N_lower[0]+(N_upper[0]-N_lower[0])/2*(i+1);
+            new_N_lower[1] = N_lower[1]+(N_upper[1]-N_lower[1])/2*j;
+            new_N_upper[1] = N_lower[1]+(N_upper[1]-N_lower[1])/2*(j+1);
+
+            for(k = 0; k < 2; k++)
+            {
+              if(spamm_recursive_multiply_is_above_tolerance(tolerance,
+                    node_A->tree.child[i+2*k], node_B->tree.child[k+2*j]))
+              {
+#ifdef SPAMM_MULTIPLY_DEBUG
+                SPAMM_INFO("descending: C[%i][%i] (%p) <- A[%i][%i]*B[%i][%i] (%e)\n", i, j, node_C->tree.child[i+2*j],
+                    i, k, k, j, node_A->tree.child[i+2*k]->norm*node_B->tree.child[k+2*j]->norm);
+#endif
+
+                spamm_recursive_multiply(tolerance, alpha,
+                    node_A->tree.child[i+2*k], node_B->tree.child[k+2*j],
+                    node_C->tree.child[i+2*j], sgemm, number_dimensions_A,
+                    number_dimensions_B, number_dimensions_C, N, new_N_lower,
+                    new_N_upper, tier+1, chunk_tier, use_linear_tree,
+                    scratch, flop, mop);
+              }
+            }
+          }
+        }
+      }
+#else
       for(k = 0; k < 2; k++) {
         for(i = 0; i < 2; i++) {
           for(j = 0; j < 2; j++)
@@ -661,7 +860,7 @@ spamm_recursive_multiply (const spamm_norm_t tolerance,
             {
               if(node_A->tree.child[i+2*k]->norm*node_B->tree.child[k+2*j]->norm > tolerance)
               {
-#ifdef _OPENMP
+#ifdef SPAMM_NODE_LOCK
                 omp_set_lock(&node_C->lock);
 #endif
                 if(node_C->tree.child == NULL)
@@ -673,7 +872,7 @@ spamm_recursive_multiply (const spamm_norm_t tolerance,
                 {
                   node_C->tree.child[i+2*j] = spamm_recursive_new_node();
                 }
-#ifdef _OPENMP
+#ifdef SPAMM_NODE_LOCK
                 omp_unset_lock(&node_C->lock);
 #endif
 
@@ -684,8 +883,8 @@ spamm_recursive_multiply (const spamm_norm_t tolerance,
 
 #pragma omp task untied
                 {
-                  new_N_lower = calloc(number_dimensions_C, sizeof(unsigned int));
-                  new_N_upper = calloc(number_dimensions_C, sizeof(unsigned int));
+                  unsigned int new_N_lower[SPAMM_MAX_NUMBER_DIMENSIONS];
+                  unsigned int new_N_upper[SPAMM_MAX_NUMBER_DIMENSIONS];
 
                   new_N_lower[0] = N_lower[0]+(N_upper[0]-N_lower[0])/2*i;
                   new_N_upper[0] = N_lower[0]+(N_upper[0]-N_lower[0])/2*(i+1);
@@ -704,10 +903,7 @@ spamm_recursive_multiply (const spamm_norm_t tolerance,
                       node_C->tree.child[i+2*j], sgemm, number_dimensions_A,
                       number_dimensions_B, number_dimensions_C, N, new_N_lower,
                       new_N_upper, tier+1, chunk_tier, use_linear_tree,
-                      flop, mop);
-
-                  free(new_N_lower);
-                  free(new_N_upper);
+                      scratch, flop, mop);
                 }
               }
 
@@ -722,6 +918,7 @@ spamm_recursive_multiply (const spamm_norm_t tolerance,
           }
         }
       }
+#endif
 #pragma omp taskwait
 
       /* Add up norms. */
@@ -745,6 +942,24 @@ spamm_recursive_multiply (const spamm_norm_t tolerance,
   }
 }
 
+/** Update the counters of a matrix for @f$ A \leftarrow \alpha A @f$.
+ *
+ * @param alpha The scalar.
+ * @param A The matrix.
+ */
+static void
+spamm_multiply_scalar_counters (const double alpha,
+    struct spamm_matrix_t *const A)
+{
+  A->trace *= alpha;
+
+  if(alpha == 0)
+  {
+    A->number_nonzero = 0;
+    A->number_nonzero_valid = 1;
+  }
+}
+
 /** Multiply a matrix by a scalar, @f$ A \leftarrow \alpha A @f$.
  *
  * @param alpha The scalar.
@@ -752,7 +967,7 @@ spamm_recursive_multiply (const spamm_norm_t tolerance,
  * @param flop The flop count.
  */
 void
-spamm_multiply_scalar (const float alpha,
+spamm_multiply_scalar (const double alpha,
     struct spamm_matrix_t *const A,
     double *const flop,
     double *const mop)
@@ -760,6 +975,8 @@ spamm_multiply_scalar (const float alpha,
   spamm_recursive_multiply_scalar(alpha, A->recursive_tree,
       A->number_dimensions, 0, A->chunk_tier, A->use_linear_tree, flop,
       mop);
+
+  spamm_multiply_scalar_counters(alpha, A);
 }
 
 /** Multiply two matrices, i.e. \f$ C = \alpha A \times B + \beta C\f$.
@@ -776,18 +993,20 @@ spamm_multiply_scalar (const float alpha,
  */
 void
 spamm_multiply (const spamm_norm_t tolerance,
-    const float alpha,
+    const double alpha,
     const struct spamm_matrix_t *const A,
     const struct spamm_matrix_t *const B,
-    const float beta,
+    const double beta,
     struct spamm_matrix_t *const C,
     sgemm_func sgemm,
     double *const flop,
     double *const mop)
 {
   int dim;
-  unsigned int *N_lower;
-  unsigned int *N_upper;
+  unsigned int N_lower[SPAMM_MAX_NUMBER_DIMENSIONS];
+  unsigned int N_upper[SPAMM_MAX_NUMBER_DIMENSIONS];
+
+  struct spamm_multiply_scratch_t *scratch = NULL;
 
   assert(A != NULL);
   assert(B != NULL);
@@ -795,10 +1014,17 @@ spamm_multiply (const spamm_norm_t tolerance,
   assert(flop != NULL);
   assert(mop != NULL);
 
+  if(A->precision != B->precision || A->precision != C->precision)
+  {
+    SPAMM_FATAL("A, B, and C have to be of the same precision\n");
+  }
+
   spamm_recursive_multiply_scalar(beta, C->recursive_tree,
       C->number_dimensions, 0, C->chunk_tier, C->use_linear_tree, flop,
       mop);
 
+  spamm_multiply_scalar_counters(beta, C);
+
   if(alpha != 0.0)
   {
     /* Allocate a new tree node before we enter the recursive portion of the
@@ -810,35 +1036,41 @@ spamm_multiply (const spamm_norm_t tolerance,
       C->recursive_tree = spamm_recursive_new_node();
     }
 
+    /* The stream buffers of the linear multiply are sized for the chunks of
+     * this product, and reused by each thread across all its chunk products. */
+    if(A->use_linear_tree)
+    {
+      scratch = spamm_multiply_scratch_new((A->N_padded >> A->chunk_tier)/SPAMM_N_KERNEL);
+    }
+
 #pragma omp parallel
     {
 #pragma omp single
       {
 #pragma omp task untied
         {
-          /* Allocate and set within task region. Otherwise we will end up
-           * with wrong N_{upper,lower} values in the
-           * spamm_recursive_multiply() call. */
-          N_lower = calloc(C->number_dimensions, sizeof(unsigned int));
-          N_upper = calloc(C->number_dimensions, sizeof(unsigned int));
-
+          /* Set within task region. Otherwise we will end up with wrong
+           * N_{upper,lower} values in the spamm_recursive_multiply() call. */
           for(dim = 0; dim < A->number_dimensions; dim++)
           {
+            N_lower[dim] = 0;
             N_upper[dim] = A->N_padded;
           }
 
           spamm_recursive_multiply(tolerance, alpha, A->recursive_tree,
               B->recursive_tree, C->recursive_tree, sgemm, A->number_dimensions,
               B->number_dimensions, C->number_dimensions, A->N, N_lower, N_upper, 0,
-              A->chunk_tier, A->use_linear_tree, flop, mop);
-
-          free(N_lower);
-          free(N_upper);
+              A->chunk_tier, A->use_linear_tree, scratch, flop, mop);
         }
       }
     }
 
+    spamm_multiply_scratch_delete(&scratch);
+
     /* Prune tree. */
     spamm_prune(C);
+
+    C->number_nonzero_valid = 0;
+    C->trace_valid = 0;
   }
 }
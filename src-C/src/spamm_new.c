@@ -103,26 +103,33 @@ spamm_get_tree_depth (const unsigned int number_dimensions,
  *   unsigned int *N_block_pointer;
  *   unsigned int *N_lower_pointer;
  *   unsigned int *N_upper_pointer;
- *   float        *A_pointer;
+ *   void         *A_pointer;
  *   float        *A_dilated_pointer;
  *   spamm_norm_t *norm_pointer;
  *   spamm_norm_t *norm2_pointer;
+ *   unsigned int *index_A_pointer;
+ *   unsigned int *index_B_pointer;
  *
  *   unsigned int number_dimensions;
  *   unsigned int N_block;
+ *   unsigned int precision;
  *   unsigned int N_lower[number_dimensions];
  *   unsigned int N_upper[number_dimensions];
  *
- *   spamm_float_t *A;
- *   spamm_float_t *A_dilated;
+ *   float or double *A; (depending on precision)
+ *   float *A_dilated; (only with SPAMM_USE_DILATED_MATRIX, in single precision)
  *
  *   spamm_norm_t norm[];
  *   spamm_norm_t norm2[];
+ *
+ *   unsigned int index_A[]; (only for 2-dimensional linear chunks)
+ *   unsigned int index_B[]; (only for 2-dimensional linear chunks)
  * };
  * \endcode
  *
  * @param number_dimensions The number of dimensions.
  * @param use_linear_tree Whether to use the linear code for the chunk or not.
+ * @param precision The precision of the matrix elements.
  * @param N The size of original matrix (unpadded).
  * @param N_lower The lower bounds of the bounding box.
  * @param N_lower The upper bounds of the bounding box.
@@ -130,8 +137,9 @@ spamm_get_tree_depth (const unsigned int number_dimensions,
  * @return A pointer to the newly allocated chunk.
  */
 spamm_chunk_t *
-spamm_new_chunk (const unsigned int number_dimensions,
+spamm_new_chunk_precision (const unsigned int number_dimensions,
     const short use_linear_tree,
+    const enum spamm_precision_t precision,
     const unsigned int *const N,
     const unsigned int *const N_lower,
     const unsigned int *const N_upper)
@@ -144,19 +152,21 @@ spamm_new_chunk (const unsigned int number_dimensions,
   unsigned int *N_pointer;
   unsigned int *N_lower_pointer;
   unsigned int *N_upper_pointer;
-  float *A_pointer;
+  void *A_pointer;
   float *A_dilated_pointer;
   spamm_norm_t *norm_pointer;
   spamm_norm_t *norm2_pointer;
+  unsigned int *index_A_pointer;
+  unsigned int *index_B_pointer;
 
   int dim;
 
   spamm_chunk_t *chunk;
 
   chunk = spamm_allocate(spamm_chunk_get_size_for_allocation(number_dimensions,
-        use_linear_tree, &number_tiers, N_lower, N_upper, &N_pointer,
+        use_linear_tree, precision, &number_tiers, N_lower, N_upper, &N_pointer,
         &N_lower_pointer, &N_upper_pointer, &A_pointer, &A_dilated_pointer,
-        &norm_pointer, &norm2_pointer), 1);
+        &norm_pointer, &norm2_pointer, &index_A_pointer, &index_B_pointer), 1);
 
   int_pointer = chunk;
   pointer_pointer = (void**) ((intptr_t) chunk + 4*sizeof(unsigned int));
@@ -164,6 +174,7 @@ spamm_new_chunk (const unsigned int number_dimensions,
   int_pointer[0] = number_dimensions;
   int_pointer[1] = number_tiers;
   int_pointer[2] = use_linear_tree;
+  int_pointer[3] = precision;
 
   pointer_pointer[0] = (void*) N_pointer;
   pointer_pointer[1] = (void*) N_lower_pointer;
@@ -172,6 +183,8 @@ spamm_new_chunk (const unsigned int number_dimensions,
   pointer_pointer[4] = (void*) A_dilated_pointer;
   pointer_pointer[5] = (void*) norm_pointer;
   pointer_pointer[6] = (void*) norm2_pointer;
+  pointer_pointer[7] = (void*) index_A_pointer;
+  pointer_pointer[8] = (void*) index_B_pointer;
 
   /* Store bounding box. */
   N_pointer       = (unsigned int*) ((intptr_t) chunk + (intptr_t) N_pointer);
@@ -185,9 +198,34 @@ spamm_new_chunk (const unsigned int number_dimensions,
     N_upper_pointer[dim] = N_upper[dim];
   }
 
+  /* All norms are zero, this only groups the indices along k. */
+  spamm_chunk_sort_index(chunk);
+
   return chunk;
 }
 
+/** Allocate a single precision SpAMM data chunk. See
+ * spamm_new_chunk_precision().
+ *
+ * @param number_dimensions The number of dimensions.
+ * @param use_linear_tree Whether to use the linear code for the chunk or not.
+ * @param N The size of original matrix (unpadded).
+ * @param N_lower The lower bounds of the bounding box.
+ * @param N_lower The upper bounds of the bounding box.
+ *
+ * @return A pointer to the newly allocated chunk.
+ */
+spamm_chunk_t *
+spamm_new_chunk (const unsigned int number_dimensions,
+    const short use_linear_tree,
+    const unsigned int *const N,
+    const unsigned int *const N_lower,
+    const unsigned int *const N_upper)
+{
+  return spamm_new_chunk_precision(number_dimensions, use_linear_tree,
+      single_precision, N, N_lower, N_upper);
+}
+
 /** Allocate a new node of a recursive matrix tree.
  *
  * @param tier The tier this node will be on.
@@ -212,7 +250,7 @@ spamm_recursive_new_node ()
   /* Allocate memory. */
   node = calloc(1, sizeof(struct spamm_recursive_node_t));
 
-#ifdef _OPENMP
+#ifdef SPAMM_NODE_LOCK
   omp_init_lock(&node->lock);
 #endif
 
@@ -235,19 +273,26 @@ spamm_recursive_new_node ()
  * @param use_linear_tree If set to zero, then the tree will be stored in the
  * hierachical format, otherwise storage will switch to linear format at
  * chunk_tier.
+ * @param precision The precision of the matrix elements.
  *
  * @return The newly allocated matrix. This matrix has to be freed by calling
  * spamm_delete().
  */
 struct spamm_matrix_t *
-spamm_new (const unsigned int number_dimensions,
+spamm_new_precision (const unsigned int number_dimensions,
     const unsigned int *const N,
     const unsigned int chunk_tier,
-    const short use_linear_tree)
+    const short use_linear_tree,
+    const enum spamm_precision_t precision)
 {
   int dim;
   struct spamm_matrix_t *A = NULL;
 
+  if(number_dimensions > SPAMM_MAX_NUMBER_DIMENSIONS)
+  {
+    SPAMM_FATAL("number_dimensions (%u) > %u\n", number_dimensions, SPAMM_MAX_NUMBER_DIMENSIONS);
+  }
+
   for(dim = 0; dim < number_dimensions; dim++)
   {
     if(N[dim] == 0)
@@ -274,6 +319,12 @@ spamm_new (const unsigned int number_dimensions,
     A->use_linear_tree = use_linear_tree;
   }
 
+  A->precision = precision;
+
+  /* The matrix is empty, so the counters are trivially up to date. */
+  A->number_nonzero_valid = 1;
+  A->trace_valid = 1;
+
   if(number_dimensions != 2 && use_linear_tree)
   {
     SPAMM_FATAL("the linear tree can only be used in 2 dimensions\n");
@@ -316,3 +367,28 @@ spamm_new (const unsigned int number_dimensions,
   /* Done. */
   return A;
 }
+
+/** Initialize a new single precision matrix object. See
+ * spamm_new_precision().
+ *
+ * @param number_dimensions The number of dimensions of this matrix.
+ * @param N The number of rows/columns of the matrix. This array has to have
+ * a size of number_dimensions.
+ * @param chunk_tier The tier at which to store contiguous submatrix
+ * blocks in the hierarhical tree.
+ * @param use_linear_tree If set to zero, then the tree will be stored in the
+ * hierachical format, otherwise storage will switch to linear format at
+ * chunk_tier.
+ *
+ * @return The newly allocated matrix. This matrix has to be freed by calling
+ * spamm_delete().
+ */
+struct spamm_matrix_t *
+spamm_new (const unsigned int number_dimensions,
+    const unsigned int *const N,
+    const unsigned int chunk_tier,
+    const short use_linear_tree)
+{
+  return spamm_new_precision(number_dimensions, N, chunk_tier,
+      use_linear_tree, single_precision);
+}
@@ -85,6 +85,7 @@ spamm_print_chunk (const spamm_chunk_t *const chunk)
   printf(", ntiers = %u", number_tiers);
   printf(", N_cont = %u", N_contiguous);
   printf(", lintree = %u", use_linear_tree);
+  printf(", precision = %u", *spamm_chunk_get_precision(chunk));
   printf("\n");
   N = spamm_chunk_get_N(chunk);
   printf("N = [");
@@ -144,12 +145,31 @@ spamm_print_chunk (const spamm_chunk_t *const chunk)
   }
 
   printf("matrix:\n");
-  A = spamm_chunk_get_matrix(chunk);
-  spamm_print_dense(N_contiguous, N_contiguous, row_major, A);
+  if(*spamm_chunk_get_precision(chunk) == double_precision)
+  {
+    for(i = 0; i < N_contiguous; i++) {
+      for(j = 0; j < N_contiguous; j++)
+      {
+        printf(" % 1.2e", spamm_chunk_get_matrix_element(spamm_index_row_major(i, j,
+                N_contiguous, N_contiguous), chunk));
+      }
+      printf("\n");
+    }
+  }
 
-  printf("matrix dilated:\n");
-  A = spamm_chunk_get_matrix_dilated(chunk);
-  spamm_print_dense(4*N_contiguous, N_contiguous, row_major, A);
+  else
+  {
+    A = spamm_chunk_get_matrix(chunk);
+    spamm_print_dense(N_contiguous, N_contiguous, row_major, A);
+  }
+
+#ifdef SPAMM_USE_DILATED_MATRIX
+  if((A = spamm_chunk_get_matrix_dilated(chunk)) != NULL)
+  {
+    printf("matrix dilated:\n");
+    spamm_print_dense(4*N_contiguous, N_contiguous, row_major, A);
+  }
+#endif
 }
 
 /** Print a recursive tree node and all nodes underneath.
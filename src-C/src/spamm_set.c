@@ -16,10 +16,12 @@
  * @param i The row/column index array.
  * @param Aij The value of the matrix element.
  * @param chunk The SpAMM chunk.
+ *
+ * @return The previous value of the matrix element.
  */
-void
+double
 spamm_chunk_set (const unsigned int *const i,
-    const float Aij,
+    const double Aij,
     spamm_chunk_t *chunk)
 {
   short use_linear_tree;
@@ -36,7 +38,12 @@ spamm_chunk_set (const unsigned int *const i,
   spamm_norm_t *norm2;
 
   float *A;
+  double *A_double;
+#ifdef SPAMM_USE_DILATED_MATRIX
   float *A_dilated;
+#endif
+  double Aij_old;
+  double Aij2;
 
   number_dimensions = *spamm_chunk_get_number_dimensions(chunk);
   use_linear_tree = *spamm_chunk_get_use_linear_tree(chunk);
@@ -44,19 +51,35 @@ spamm_chunk_set (const unsigned int *const i,
   N_lower = spamm_chunk_get_N_lower(chunk);
   N_upper = spamm_chunk_get_N_upper(chunk);
 
-  A = spamm_chunk_get_matrix(chunk);
-  A_dilated = spamm_chunk_get_matrix_dilated(chunk);
-
   offset = spamm_chunk_matrix_index(number_dimensions, use_linear_tree, N_lower, N_upper, i);
 
   /* Set the matrix element. */
-  A[offset] = Aij;
-  A_dilated[0+4*offset] = Aij;
-  A_dilated[1+4*offset] = Aij;
-  A_dilated[2+4*offset] = Aij;
-  A_dilated[3+4*offset] = Aij;
+  if(*spamm_chunk_get_precision(chunk) == double_precision)
+  {
+    A_double = spamm_chunk_get_matrix_double(chunk);
+    Aij_old = A_double[offset];
+    A_double[offset] = Aij;
+  }
+
+  else
+  {
+    A = spamm_chunk_get_matrix(chunk);
+    Aij_old = A[offset];
+    A[offset] = Aij;
+
+#ifdef SPAMM_USE_DILATED_MATRIX
+    A_dilated = spamm_chunk_get_matrix_dilated(chunk);
+    A_dilated[0+4*offset] = Aij;
+    A_dilated[1+4*offset] = Aij;
+    A_dilated[2+4*offset] = Aij;
+    A_dilated[3+4*offset] = Aij;
+#endif
+  }
+
+  /* Set the norms. The square is taken in the precision of the chunk, as
+   * it is in spamm_chunk_fix(). */
+  Aij2 = (*spamm_chunk_get_precision(chunk) == double_precision ? Aij*Aij : (float) (Aij*Aij));
 
-  /* Set the norms. */
   for(tier = 0; tier < *spamm_chunk_get_number_tiers(chunk); tier++)
   {
     norm = spamm_chunk_get_tier_norm(tier, chunk);
@@ -64,9 +87,18 @@ spamm_chunk_set (const unsigned int *const i,
 
     offset = spamm_chunk_norm_index(tier, i, chunk);
 
-    norm2[offset] += Aij*Aij;
+    norm2[offset] += Aij2;
     norm[offset] = sqrt(norm2[offset]);
+
+    /* The norm of the kernel block changed, keep its sorted indices in
+     * order. */
+    if(use_linear_tree && tier == *spamm_chunk_get_number_tiers(chunk)-SPAMM_KERNEL_DEPTH-1)
+    {
+      spamm_chunk_sort_index_block(offset, chunk);
+    }
   }
+
+  return Aij_old;
 }
 
 /** Recursively set a matrix element.
@@ -81,9 +113,12 @@ spamm_chunk_set (const unsigned int *const i,
  * @param chunk_tier The size of the contiguous submatrix block.
  * @param linear_tier The size of the submatrix that is stored in hashed format.
  * @param layout The layout of the matrix elements.
+ * @param precision The precision of the matrix elements.
  * @param node The node.
+ *
+ * @return The previous value of the matrix element.
  */
-void
+double
 spamm_recursive_set (const unsigned int number_dimensions,
     const unsigned int *const i,
     const unsigned int *const N,
@@ -92,35 +127,38 @@ spamm_recursive_set (const unsigned int number_dimensions,
     const unsigned int tier,
     const unsigned int chunk_tier,
     const short use_linear_tree,
+    const enum spamm_precision_t precision,
     const unsigned int depth,
-    const float Aij,
+    const double Aij,
     struct spamm_recursive_node_t **node)
 {
   int dim;
 
-  unsigned int *new_N_lower;
-  unsigned int *new_N_upper;
+  unsigned int new_N_lower[SPAMM_MAX_NUMBER_DIMENSIONS];
+  unsigned int new_N_upper[SPAMM_MAX_NUMBER_DIMENSIONS];
 
   short child_index;
 
+  double Aij_old;
+
   if(*node == NULL)
   {
     *node = spamm_recursive_new_node();
   }
 
-  /* Update norm. */
-  (*node)->norm2 += Aij*Aij;
+  /* Update norm, with the square in the precision of the matrix. */
+  (*node)->norm2 += (precision == double_precision ? Aij*Aij : (float) (Aij*Aij));
   (*node)->norm   = sqrt((*node)->norm2);
 
   if(tier == chunk_tier)
   {
     if((*node)->tree.chunk == NULL)
     {
-      (*node)->tree.chunk = spamm_new_chunk(number_dimensions,
-          use_linear_tree, N, N_lower, N_upper);
+      (*node)->tree.chunk = spamm_new_chunk_precision(number_dimensions,
+          use_linear_tree, precision, N, N_lower, N_upper);
     }
 
-    spamm_chunk_set(i, Aij, (*node)->tree.chunk);
+    Aij_old = spamm_chunk_set(i, Aij, (*node)->tree.chunk);
   }
 
   else
@@ -130,9 +168,6 @@ spamm_recursive_set (const unsigned int number_dimensions,
       (*node)->tree.child = calloc(ipow(2, number_dimensions), sizeof(struct spamm_recursive_node_t*));
     }
 
-    new_N_lower = calloc(number_dimensions, sizeof(unsigned int));
-    new_N_upper = calloc(number_dimensions, sizeof(unsigned int));
-
     child_index = 0;
 
     for(dim = 0; dim < number_dimensions; dim++)
@@ -151,40 +186,65 @@ spamm_recursive_set (const unsigned int number_dimensions,
       }
     }
 
-    spamm_recursive_set(number_dimensions, i, N, new_N_lower, new_N_upper,
-        tier+1, chunk_tier, use_linear_tree, depth, Aij,
+    Aij_old = spamm_recursive_set(number_dimensions, i, N, new_N_lower, new_N_upper,
+        tier+1, chunk_tier, use_linear_tree, precision, depth, Aij,
         &(*node)->tree.child[child_index]);
-
-    free(new_N_lower);
-    free(new_N_upper);
   }
+
+  return Aij_old;
 }
 
-/** Set an element in a matrix.
+/** Set an element in a matrix, in double precision. The element is rounded
+ * to the precision of the matrix.
+ *
+ * The number of non-zero elements and the trace of the matrix are updated
+ * along with the element, so that they stay current without a traversal.
  *
  * @param i The row/column index.
  * @param Aij The value of the matrix element A(i,j).
  * @param A The matrix.
  */
 void
-spamm_set (const unsigned int *const i, const float Aij, struct spamm_matrix_t *A)
+spamm_set_double (const unsigned int *const i, const double Aij, struct spamm_matrix_t *A)
 {
-  unsigned int *N_lower;
-  unsigned int *N_upper;
+  unsigned int N_lower[SPAMM_MAX_NUMBER_DIMENSIONS];
+  unsigned int N_upper[SPAMM_MAX_NUMBER_DIMENSIONS];
 
   int dim;
 
-  N_lower = calloc(A->number_dimensions, sizeof(unsigned int));
-  N_upper = calloc(A->number_dimensions, sizeof(unsigned int));
+  double Aij_stored;
+  double Aij_old;
+
+  /* Keep the norms consistent with the stored element. */
+  Aij_stored = (A->precision == single_precision ? (float) Aij : Aij);
 
   for(dim = 0; dim < A->number_dimensions; dim++)
   {
+    N_lower[dim] = 0;
     N_upper[dim] = A->N_padded;
   }
 
-  spamm_recursive_set(A->number_dimensions, i, A->N, N_lower, N_upper, 0,
-      A->chunk_tier, A->use_linear_tree, A->depth, Aij, &(A->recursive_tree));
+  Aij_old = spamm_recursive_set(A->number_dimensions, i, A->N, N_lower, N_upper, 0,
+      A->chunk_tier, A->use_linear_tree, A->precision, A->depth, Aij_stored,
+      &(A->recursive_tree));
+
+  /* Update the counters. */
+  A->number_nonzero += (Aij_stored != 0) - (Aij_old != 0);
 
-  free(N_lower);
-  free(N_upper);
+  if(A->number_dimensions == 2 && i[0] == i[1])
+  {
+    A->trace += Aij_stored-Aij_old;
+  }
+}
+
+/** Set an element in a matrix. See spamm_set_double().
+ *
+ * @param i The row/column index.
+ * @param Aij The value of the matrix element A(i,j).
+ * @param A The matrix.
+ */
+void
+spamm_set (const unsigned int *const i, const float Aij, struct spamm_matrix_t *A)
+{
+  spamm_set_double(i, Aij, A);
 }
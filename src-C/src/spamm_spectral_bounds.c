@@ -4,8 +4,144 @@
 #include "spamm_types_private.h"
 
 #include <math.h>
+#include <stdlib.h>
+
+/** Get the offset of a matrix element inside a chunk matrix.
+ *
+ * This is spamm_chunk_matrix_index() for 2-dimensional chunks, without the
+ * temporary index arrays.
+ *
+ * @param use_linear_tree Whether we are using the linear tree.
+ * @param N_contiguous The size of the chunk matrix.
+ * @param i The row index, relative to the chunk's lower corner.
+ * @param j The column index, relative to the chunk's lower corner.
+ *
+ * @return The linear offset into the chunk matrix.
+ */
+static inline unsigned int
+spamm_spectral_bounds_chunk_offset (const short use_linear_tree,
+    const unsigned int N_contiguous,
+    const unsigned int i,
+    const unsigned int j)
+{
+  unsigned int i_kernel[2];
+
+  if(!use_linear_tree)
+  {
+    return i+j*N_contiguous;
+  }
+
+  /* Z-curve ordered kernel blocks of row-major basic blocks. */
+  i_kernel[0] = i/SPAMM_N_KERNEL;
+  i_kernel[1] = j/SPAMM_N_KERNEL;
+
+  return SPAMM_N_KERNEL*SPAMM_N_KERNEL*spamm_index_linear(2, i_kernel)
+    +spamm_index_kernel_block(i%SPAMM_N_KERNEL, j%SPAMM_N_KERNEL, row_major);
+}
+
+/** Accumulate the diagonal and the off-diagonal absolute row sums of a
+ * chunk.
+ *
+ * @param N The size of the (unpadded) matrix.
+ * @param chunk The chunk.
+ * @param diagonal The diagonal elements.
+ * @param rowsum The off-diagonal absolute row sums.
+ */
+static void
+spamm_spectral_bounds_chunk (const unsigned int *const N,
+    const spamm_chunk_t *const chunk,
+    double *const diagonal,
+    double *const rowsum)
+{
+  unsigned int i, j;
+  unsigned int i_upper, j_upper;
+  unsigned int N_contiguous;
+  unsigned int *N_lower;
+  short use_linear_tree;
+  double Aij;
+
+  N_lower = spamm_chunk_get_N_lower(chunk);
+  N_contiguous = spamm_chunk_get_N_contiguous(chunk);
+  use_linear_tree = *spamm_chunk_get_use_linear_tree(chunk);
+
+  /* Skip the padding. */
+  i_upper = (N_lower[0]+N_contiguous < N[0] ? N_contiguous : N[0]-N_lower[0]);
+  j_upper = (N_lower[1]+N_contiguous < N[1] ? N_contiguous : N[1]-N_lower[1]);
+
+  for(j = 0; j < j_upper; j++) {
+    for(i = 0; i < i_upper; i++)
+    {
+      Aij = spamm_chunk_get_matrix_element(spamm_spectral_bounds_chunk_offset(use_linear_tree,
+            N_contiguous, i, j), chunk);
+
+      if(N_lower[0]+i == N_lower[1]+j)
+      {
+        diagonal[N_lower[0]+i] = Aij;
+      }
+
+      else
+      {
+        rowsum[N_lower[0]+i] += fabs(Aij);
+      }
+    }
+  }
+}
+
+/** Accumulate the diagonal and the off-diagonal absolute row sums of a
+ * recursive matrix.
+ *
+ * The two row halves of a node touch disjoint parts of diagonal[] and
+ * rowsum[], so they are taken as separate tasks. Empty subtrees are
+ * skipped.
+ *
+ * @param N The size of the (unpadded) matrix.
+ * @param tier The tier of this node.
+ * @param chunk_tier The chunk tier.
+ * @param node The node.
+ * @param diagonal The diagonal elements.
+ * @param rowsum The off-diagonal absolute row sums.
+ */
+static void
+spamm_recursive_spectral_bounds (const unsigned int *const N,
+    const unsigned int tier,
+    const unsigned int chunk_tier,
+    const struct spamm_recursive_node_t *const node,
+    double *const diagonal,
+    double *const rowsum)
+{
+  short row;
+
+  if(node == NULL) { return; }
+
+  if(tier == chunk_tier)
+  {
+    if(node->tree.chunk != NULL)
+    {
+      spamm_spectral_bounds_chunk(N, node->tree.chunk, diagonal, rowsum);
+    }
+  }
+
+  else if(node->tree.child != NULL)
+  {
+    /* Children are indexed with the row in bit 0 and the column in bit 1. */
+    for(row = 0; row < 2; row++)
+    {
+#pragma omp task untied
+      {
+        spamm_recursive_spectral_bounds(N, tier+1, chunk_tier,
+            node->tree.child[row], diagonal, rowsum);
+        spamm_recursive_spectral_bounds(N, tier+1, chunk_tier,
+            node->tree.child[row | 2], diagonal, rowsum);
+      }
+    }
+#pragma omp taskwait
+  }
+}
 
 /** Calculate the spectral bounds on A using the Gershgorin circle theorem.
+ *
+ * The row sums are accumulated directly from the chunk matrices, in a
+ * parallel traversal of the allocated part of the tree.
  *
  * @param [out] a_min The lower spectral bound.
  * @param [out] a_max The upper spectral bound.
@@ -16,10 +152,9 @@ spamm_spectral_bounds (float *const a_min,
     float *const a_max,
     struct spamm_matrix_t *A)
 {
-  unsigned int i[2];
-  float rowsum;
-  float a_min_temp;
-  float a_max_temp;
+  unsigned int i;
+  double *diagonal;
+  double *rowsum;
 
   if(A->number_dimensions != 2)
   {
@@ -31,29 +166,115 @@ spamm_spectral_bounds (float *const a_min,
     SPAMM_FATAL("Spectral bounds can only be calculated for a square matrix\n");
   }
 
-  for(i[0] = 0; i[0] < A->N[0]; i[0]++) {
-    for(i[1] = 0, rowsum = 0; i[1] < A->N[1]; i[1]++)
+  diagonal = calloc(A->N[0], sizeof(double));
+  rowsum = calloc(A->N[0], sizeof(double));
+
+#pragma omp parallel
+  {
+#pragma omp single
     {
-      if(i[0] != i[1])
-      {
-        rowsum += fabsf(spamm_get(i, A));
-      }
+#pragma omp task untied
+      spamm_recursive_spectral_bounds(A->N, 0, A->chunk_tier,
+          A->recursive_tree, diagonal, rowsum);
     }
+  }
 
-    i[1] = i[0];
-    a_min_temp = spamm_get(i, A)-rowsum;
-    a_max_temp = spamm_get(i, A)+rowsum;
+  for(i = 0; i < A->N[0]; i++)
+  {
+    if(i == 0 || diagonal[i]-rowsum[i] < *a_min) { *a_min = diagonal[i]-rowsum[i]; }
+    if(i == 0 || diagonal[i]+rowsum[i] > *a_max) { *a_max = diagonal[i]+rowsum[i]; }
+  }
 
-    if(i[0] == 0)
-    {
-      *a_min = a_min_temp;
-      *a_max = a_max_temp;
-    }
+  free(diagonal);
+  free(rowsum);
+}
+
+/** Accumulate the norms of the chunks of a recursive matrix into block row
+ * sums.
+ *
+ * @param tier The tier of this node.
+ * @param chunk_tier The chunk tier.
+ * @param block_row The block row of this node, in units of its own size.
+ * @param node The node.
+ * @param block_rowsum The block row sums of the chunk norms.
+ */
+static void
+spamm_recursive_spectral_bounds_norm (const unsigned int tier,
+    const unsigned int chunk_tier,
+    const unsigned int block_row,
+    const struct spamm_recursive_node_t *const node,
+    double *const block_rowsum)
+{
+  short i;
 
-    else
+  if(node == NULL) { return; }
+
+  if(tier == chunk_tier)
+  {
+    block_rowsum[block_row] += node->norm;
+  }
+
+  else if(node->tree.child != NULL)
+  {
+    for(i = 0; i < 4; i++)
     {
-      if(a_min_temp < *a_min) { *a_min = a_min_temp; }
-      if(a_max_temp > *a_max) { *a_max = a_max_temp; }
+      spamm_recursive_spectral_bounds_norm(tier+1, chunk_tier,
+          2*block_row+(i & 1), node->tree.child[i], block_rowsum);
     }
   }
 }
+
+/** Calculate symmetric spectral bounds on A from the stored norms alone.
+ *
+ * For symmetric A, the spectral radius is bounded by the largest block row
+ * sum of the chunk norms, and by the F-norm of A. No matrix elements are
+ * touched, so this is much cheaper, but also looser, than
+ * spamm_spectral_bounds().
+ *
+ * @param [out] a_min The lower spectral bound.
+ * @param [out] a_max The upper spectral bound.
+ * @param A The matrix.
+ */
+void
+spamm_spectral_bounds_norm (float *const a_min,
+    float *const a_max,
+    const struct spamm_matrix_t *const A)
+{
+  unsigned int i;
+  unsigned int number_blocks;
+  double *block_rowsum;
+  double radius;
+
+  if(A->number_dimensions != 2)
+  {
+    SPAMM_FATAL("Spectral bounds can only be calculated using this method for rank 2 matrix\n");
+  }
+
+  if(A->N[0] != A->N[1])
+  {
+    SPAMM_FATAL("Spectral bounds can only be calculated for a square matrix\n");
+  }
+
+  *a_min = 0;
+  *a_max = 0;
+
+  if(A->recursive_tree == NULL) { return; }
+
+  number_blocks = ipow(2, A->chunk_tier);
+  block_rowsum = calloc(number_blocks, sizeof(double));
+
+  spamm_recursive_spectral_bounds_norm(0, A->chunk_tier, 0, A->recursive_tree,
+      block_rowsum);
+
+  for(i = 0, radius = 0; i < number_blocks; i++)
+  {
+    if(block_rowsum[i] > radius) { radius = block_rowsum[i]; }
+  }
+
+  if(A->recursive_tree->norm < radius) { radius = A->recursive_tree->norm; }
+
+  *a_min = -radius;
+  *a_max = radius;
+
+  free(block_rowsum);
+}
@@ -7,63 +7,101 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+/** Count the number of non-zero elements in a recursive matrix.
+ *
+ * The chunk matrices are scanned directly, see
+ * spamm_chunk_number_nonzero_float(). The children are counted as separate
+ * tasks.
+ *
+ * @param number_dimensions The number of dimensions.
+ * @param tier The tier of this node.
+ * @param chunk_tier The chunk tier.
+ * @param node The node.
+ *
+ * @return The number of non-zero elements under this node.
+ */
+static unsigned int
+spamm_recursive_number_nonzero (const unsigned int number_dimensions,
+    const unsigned int tier,
+    const unsigned int chunk_tier,
+    const struct spamm_recursive_node_t *const node)
+{
+  unsigned int i;
+  unsigned int *number_nonzero_child;
+  unsigned int result = 0;
+
+  if(node == NULL) { return 0; }
+
+  if(tier == chunk_tier)
+  {
+    if(node->tree.chunk == NULL) { return 0; }
+
+    if(*spamm_chunk_get_precision(node->tree.chunk) == double_precision)
+    {
+      return spamm_chunk_number_nonzero_double(node->tree.chunk);
+    }
+
+    return spamm_chunk_number_nonzero_float(node->tree.chunk);
+  }
+
+  if(node->tree.child == NULL) { return 0; }
+
+  number_nonzero_child = calloc(ipow(2, number_dimensions), sizeof(unsigned int));
+
+  for(i = 0; i < ipow(2, number_dimensions); i++)
+  {
+    if(node->tree.child[i] != NULL)
+    {
+#pragma omp task untied
+      number_nonzero_child[i] = spamm_recursive_number_nonzero(number_dimensions,
+          tier+1, chunk_tier, node->tree.child[i]);
+    }
+  }
+#pragma omp taskwait
+
+  for(i = 0; i < ipow(2, number_dimensions); i++)
+  {
+    result += number_nonzero_child[i];
+  }
+
+  free(number_nonzero_child);
+
+  return result;
+}
+
 /** Return the number of non-zero elements in a matrix.
+ *
+ * If the count has been kept up to date by the operations on A, it is
+ * returned directly. Otherwise the chunks are counted in a parallel
+ * traversal, and the count is cached in A until the next operation that
+ * invalidates it.
  *
  * @param A The matrix.
  *
  * @return The number of non-zero elements.
  */
 unsigned int
-spamm_number_nonzero (const struct spamm_matrix_t *const A)
+spamm_number_nonzero (struct spamm_matrix_t *const A)
 {
-  unsigned int *i;
   unsigned int result = 0;
 
-  i = calloc(A->number_dimensions, sizeof(unsigned int));
+  if(A->number_nonzero_valid)
+  {
+    return A->number_nonzero;
+  }
 
-  switch(A->number_dimensions)
+#pragma omp parallel
   {
-    case 1:
-      for(i[0] = 0; i[0] < A->N[0]; i[0]++)
-      {
-        if(spamm_get(i, A) != 0.0)
-        {
-          result++;
-        }
-      }
-      break;
-
-    case 2:
-      for(i[0] = 0; i[0] < A->N[0]; i[0]++) {
-        for(i[1] = 0; i[1] < A->N[1]; i[1]++)
-        {
-          if(spamm_get(i, A) != 0.0)
-          {
-            result++;
-          }
-        }
-      }
-      break;
-
-    case 3:
-      for(i[0] = 0; i[0] < A->N[0]; i[0]++) {
-        for(i[1] = 0; i[1] < A->N[1]; i[1]++) {
-          for(i[2] = 0; i[2] < A->N[2]; i[2]++)
-          {
-            if(spamm_get(i, A) != 0.0)
-            {
-              result++;
-            }
-          }
-        }
-      }
-      break;
-
-    default:
-      SPAMM_FATAL("not implemented\n");
+#pragma omp single
+    {
+#pragma omp task untied shared(result)
+      result = spamm_recursive_number_nonzero(A->number_dimensions, 0,
+          A->chunk_tier, A->recursive_tree);
+    }
   }
 
-  free(i);
+  A->number_nonzero = result;
+  A->number_nonzero_valid = 1;
 
   return result;
 }
@@ -138,7 +176,7 @@ spamm_number_nodes (unsigned int *const number_recursive_nodes,
  * @param A The matrix.
  */
 void
-spamm_print_info (const struct spamm_matrix_t *const A)
+spamm_print_info (struct spamm_matrix_t *const A)
 {
   int dim;
   unsigned int i;
@@ -148,6 +186,7 @@ spamm_print_info (const struct spamm_matrix_t *const A)
   unsigned int number_recursive_nodes_full;
   unsigned int number_chunks;
   unsigned int number_chunks_full;
+  unsigned int number_nonzero;
 
   assert(A != NULL);
 
@@ -186,6 +225,7 @@ spamm_print_info (const struct spamm_matrix_t *const A)
   printf(", chunk_tier = %u", A->chunk_tier);
   printf(", N_contiguous = %u", N_contiguous);
   printf(", use_linear_tree = %u", A->use_linear_tree);
-  printf(", nnzero = %u (%1.2f%% sparsity)", spamm_number_nonzero(A), 100*(1-(float) spamm_number_nonzero(A)/(float) N_matrix));
+  number_nonzero = spamm_number_nonzero(A);
+  printf(", nnzero = %u (%1.2f%% sparsity)", number_nonzero, 100*(1-(float) number_nonzero/(float) N_matrix));
   printf("\n");
 }
@@ -4,8 +4,104 @@
 #include "spamm_types_private.h"
 
 #include <assert.h>
+#include <stdlib.h>
+
+/** The trace of a chunk on the diagonal.
+ *
+ * @param N The size of the (unpadded) matrix.
+ * @param chunk The chunk.
+ *
+ * @return The sum of the diagonal elements of the chunk.
+ */
+static double
+spamm_chunk_trace (const unsigned int *const N,
+    const spamm_chunk_t *const chunk)
+{
+  unsigned int i;
+  unsigned int i_upper;
+  unsigned int i_kernel[2];
+  unsigned int N_contiguous;
+  unsigned int *N_lower;
+  double trace = 0;
+
+  N_lower = spamm_chunk_get_N_lower(chunk);
+  N_contiguous = spamm_chunk_get_N_contiguous(chunk);
+
+  /* Skip the padding. */
+  i_upper = (N_lower[0]+N_contiguous < N[0] ? N_contiguous : N[0]-N_lower[0]);
+
+  if(!*spamm_chunk_get_use_linear_tree(chunk))
+  {
+    for(i = 0; i < i_upper; i++)
+    {
+      trace += spamm_chunk_get_matrix_element(i*(N_contiguous+1), chunk);
+    }
+  }
+
+  else
+  {
+    /* Z-curve ordered kernel blocks of row-major basic blocks. */
+    for(i = 0; i < i_upper; i++)
+    {
+      i_kernel[0] = i/SPAMM_N_KERNEL;
+      i_kernel[1] = i_kernel[0];
+
+      trace += spamm_chunk_get_matrix_element(SPAMM_N_KERNEL*SPAMM_N_KERNEL*spamm_index_linear(2, i_kernel)
+          +spamm_index_kernel_block(i%SPAMM_N_KERNEL, i%SPAMM_N_KERNEL, row_major), chunk);
+    }
+  }
+
+  return trace;
+}
+
+/** The trace of a recursive matrix.
+ *
+ * Only the diagonal children, [00] and [11], are visited, each as its own
+ * task.
+ *
+ * @param N The size of the (unpadded) matrix.
+ * @param tier The tier of this node.
+ * @param chunk_tier The chunk tier.
+ * @param node The node.
+ *
+ * @return The trace of the node.
+ */
+static double
+spamm_recursive_trace (const unsigned int *const N,
+    const unsigned int tier,
+    const unsigned int chunk_tier,
+    const struct spamm_recursive_node_t *const node)
+{
+  short i;
+  double trace[2] = { 0, 0 };
+
+  if(node == NULL) { return 0; }
+
+  if(tier == chunk_tier)
+  {
+    if(node->tree.chunk == NULL) { return 0; }
+    return spamm_chunk_trace(N, node->tree.chunk);
+  }
+
+  if(node->tree.child == NULL) { return 0; }
+
+  for(i = 0; i < 2; i++)
+  {
+#pragma omp task untied shared(trace)
+    trace[i] = spamm_recursive_trace(N, tier+1, chunk_tier,
+        node->tree.child[3*i]);
+  }
+#pragma omp taskwait
+
+  return trace[0]+trace[1];
+}
 
 /** The trace of a matrix.
+ *
+ * If the trace has been kept up to date by the operations on A, it is
+ * returned directly. Otherwise the diagonal chunks are summed in a parallel
+ * traversal, and the trace is cached in A until the next operation that
+ * invalidates it.
  *
  * @param A The matrix.
  * @param flop The flop count.
@@ -13,11 +109,10 @@
  * @return The trace of A.
  */
 float
-spamm_trace (const struct spamm_matrix_t *const A,
+spamm_trace (struct spamm_matrix_t *const A,
     double *const flop)
 {
-  unsigned int i[2];
-  float trace;
+  double trace = 0;
 
   assert(A != NULL);
   assert(flop != NULL);
@@ -29,11 +124,23 @@ spamm_trace (const struct spamm_matrix_t *const A,
       {
         SPAMM_FATAL("not a square matrix\n");
       }
-      for(i[0] = 0, trace = 0; i[0] < A->N[0]; i[0]++)
+
+      if(A->trace_valid)
+      {
+        return A->trace;
+      }
+
+#pragma omp parallel
       {
-        i[1] = i[0];
-        trace += spamm_get(i, A);
+#pragma omp single
+        {
+#pragma omp task untied shared(trace)
+          trace = spamm_recursive_trace(A->N, 0, A->chunk_tier,
+              A->recursive_tree);
+        }
       }
+      A->trace = trace;
+      A->trace_valid = 1;
       break;
 
     default:
@@ -19,6 +19,31 @@
 
 __BEGIN_DECLARATIONS
 
+/* Some commonly used bit-patterns are:
+ *
+ * For 3D indices:
+ *
+ * 010010010010010010010010010010 = 0x12492492
+ * 101101101101101101101101101101 = 0x2DB6DB6D
+ *
+ * For 2D indices:
+ * 01010101010101010101010101010101 = 0x55555555
+ * 10101010101010101010101010101010 = 0xaaaaaaaa
+ */
+
+/** 01010101010101010101010101010101 = 0x55555555 */
+#define MASK_2D_J  0x55555555
+
+/** 10101010101010101010101010101010 = 0xaaaaaaaa */
+#define MASK_2D_I  0xaaaaaaaa
+
+#if defined(_OPENMP) && !defined(SPAMM_MULTIPLY_OWNER_COMPUTES)
+/** The tree nodes carry a lock. With owner computes scheduling in the
+ * multiply, every node is written by a single task, and the lock is not
+ * needed. */
+#define SPAMM_NODE_LOCK
+#endif
+
 /** The matrix. */
 struct spamm_matrix_t
 {
@@ -49,6 +74,22 @@ struct spamm_matrix_t
    * linear. */
   short use_linear_tree;
 
+  /** The precision of the matrix elements. */
+  enum spamm_precision_t precision;
+
+  /** The number of non-zero matrix elements. Only meaningful if
+   * number_nonzero_valid. */
+  unsigned int number_nonzero;
+
+  /** Whether number_nonzero is up to date. */
+  short number_nonzero_valid;
+
+  /** The trace of the matrix. Only meaningful if trace_valid. */
+  double trace;
+
+  /** Whether trace is up to date. */
+  short trace_valid;
+
   /** The root node of the recursive tree. */
   struct spamm_recursive_node_t *recursive_tree;
 };
@@ -68,7 +109,7 @@ spamm_recursive_node_t
   /** The square of the norm of this block. */
   spamm_norm_t norm2;
 
-#ifdef _OPENMP
+#ifdef SPAMM_NODE_LOCK
   /** A lock. */
   omp_lock_t lock;
 #endif
@@ -85,6 +126,28 @@ spamm_recursive_node_t
   tree;
 };
 
+/** @private Per-thread scratch space of the linear multiply. It is sized
+ * once per spamm_multiply(), and reused for all chunk products of a thread.
+ */
+struct spamm_multiply_scratch_t
+{
+  /** The number of kernel blocks along one side of a chunk. */
+  unsigned int index_length;
+
+  /** The number of threads, i.e. the length of the buffer array. */
+  int number_threads;
+
+  /** The buffer of each thread, holding the stream, the work space to bucket
+   * the stream, and the bucket offsets. A buffer is allocated by its thread
+   * on first use. */
+  unsigned int **buffer;
+
+  /** Whether the buffer of a thread is held by a linear multiply. The stream
+   * is run in tasks, and the thread may start another linear multiply while
+   * it waits for them. */
+  int *in_use;
+};
+
 __END_DECLARATIONS
 
 #endif
@@ -12,11 +12,18 @@ main ()
   unsigned int i, j;
   unsigned int nonzeros = 0;
 
+  float trace = 0;
+
+  double flop = 0;
+  double flop_traversal;
+  double memop = 0;
+
   const unsigned int N[] = { 1000, 1000 };
   const unsigned int chunk_tier = 5;
   const short use_linear_tree = 1;
 
   struct spamm_matrix_t *A;
+  struct spamm_matrix_t *B;
   float *A_dense;
 
   A_dense = (float*) malloc(sizeof(float)*N[0]*N[1]);
@@ -27,6 +34,7 @@ main ()
       {
         A_dense[i*N[1]+j] = 1.0;
         nonzeros++;
+        if(i == j) { trace += 1.0; }
       }
 
       else
@@ -43,6 +51,53 @@ main ()
     result = -1;
   }
 
+  if(spamm_trace(A, &flop) != trace)
+  {
+    printf("found trace %e, should have found %e\n", spamm_trace(A, &flop), trace);
+    result = -1;
+  }
+
+  /* The conversion counts as it copies, no traversal is needed. */
+  if(flop != 0)
+  {
+    printf("the conversion did not count the trace\n");
+    result = -1;
+  }
+
+  /* The transpose in the hierarchical tree has the same counts. */
+  B = spamm_convert_dense_to_spamm(2, N, chunk_tier, 0, column_major, A_dense);
+  if(spamm_number_nonzero(B) != nonzeros || spamm_trace(B, &flop) != trace || flop != 0)
+  {
+    printf("found %u nonzeros and trace %e in the column-major conversion\n",
+        spamm_number_nonzero(B), spamm_trace(B, &flop));
+    result = -1;
+  }
+  spamm_delete(&B);
+
+  /* Lose the count of non-zeros, and count again by traversal. */
+  spamm_add(1.0, A, 0.0, NULL, &flop, &memop);
+  spamm_multiply_scalar(2.0, A, &flop, &memop);
+
+  if(spamm_number_nonzero(A) != nonzeros)
+  {
+    printf("found %u nonzeros after add, should have found %u\n", spamm_number_nonzero(A), nonzeros);
+    result = -1;
+  }
+
+  if(spamm_trace(A, &flop) != 2*trace)
+  {
+    printf("found trace %e after add, should have found %e\n", spamm_trace(A, &flop), 2*trace);
+    result = -1;
+  }
+
+  /* The traversal is cached, and costs nothing the second time. */
+  flop_traversal = flop;
+  if(spamm_trace(A, &flop) != 2*trace || flop != flop_traversal)
+  {
+    printf("the trace was not cached after the traversal\n");
+    result = -1;
+  }
+
   spamm_delete(&A);
   free(A_dense);
 
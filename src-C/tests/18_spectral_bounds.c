@@ -115,6 +115,16 @@ main (int argc, char **argv)
     SPAMM_FATAL("found eigenvalue above spectral bounds\n");
   }
 
+  /* The norm-only bounds are looser, but must still hold. */
+  spamm_spectral_bounds_norm(&f_min, &f_max, A);
+
+  if(f_min_reference < f_min || f_max_reference > f_max)
+  {
+    printf("f_reference = [ %f, %f ]\n", f_min_reference, f_max_reference);
+    printf("f_norm = [ %f, %f ]\n", f_min, f_max);
+    SPAMM_FATAL("found eigenvalue outside of norm spectral bounds\n");
+  }
+
   /* Free memory. */
   free(work);
   free(vr);
@@ -0,0 +1,120 @@
+#include "config.h"
+
+#include <spamm.h>
+#include <spamm_blas.h>
+
+#include <math.h>
+#include <stdlib.h>
+
+#define REL_TOLERANCE 1e-8
+
+#define TEST_REL_TOLERANCE 1e-12
+
+int
+main ()
+{
+  int result = 0;
+
+  unsigned int N[] = { 129, 129 };
+  const unsigned int chunk_tier = 3;
+  const double alpha = 1.2;
+  const double beta = 0.5;
+
+  unsigned int i[2];
+  unsigned int k;
+  short use_linear_tree;
+  short use_sgemm;
+
+  double *A_dense;
+  double *B_dense;
+  double *C_dense;
+
+  double flop;
+  double memop;
+
+  struct spamm_matrix_t *A;
+  struct spamm_matrix_t *B;
+  struct spamm_matrix_t *C;
+
+  A_dense = calloc(N[0]*N[1], sizeof(double));
+  B_dense = calloc(N[0]*N[1], sizeof(double));
+  C_dense = calloc(N[0]*N[1], sizeof(double));
+
+  for(use_linear_tree = 0; use_linear_tree < 2; use_linear_tree++) {
+    for(use_sgemm = 0; use_sgemm < 2; use_sgemm++)
+    {
+      A = spamm_new_precision(2, N, chunk_tier, use_linear_tree, double_precision);
+      B = spamm_new_precision(2, N, chunk_tier, use_linear_tree, double_precision);
+      C = spamm_new_precision(2, N, chunk_tier, use_linear_tree, double_precision);
+
+      for(i[0] = 0; i[0] < N[0]; i[0]++) {
+        for(i[1] = 0; i[1] < N[1]; i[1]++)
+        {
+          /* Elements that are not representable in single precision. */
+          A_dense[i[0]+i[1]*N[0]] = rand()/(double) RAND_MAX/3.0;
+          B_dense[i[0]+i[1]*N[0]] = rand()/(double) RAND_MAX/3.0;
+          C_dense[i[0]+i[1]*N[0]] = rand()/(double) RAND_MAX/3.0;
+
+          spamm_set_double(i, A_dense[i[0]+i[1]*N[0]], A);
+          spamm_set_double(i, B_dense[i[0]+i[1]*N[0]], B);
+          spamm_set_double(i, C_dense[i[0]+i[1]*N[0]], C);
+        }
+      }
+
+      for(i[0] = 0; i[0] < N[0]; i[0]++) {
+        for(i[1] = 0; i[1] < N[1]; i[1]++)
+        {
+          if(spamm_get_double(i, A) != A_dense[i[0]+i[1]*N[0]])
+          {
+            SPAMM_FATAL("A(%u,%u) was not stored in double precision\n", i[0], i[1]);
+          }
+        }
+      }
+
+      for(i[0] = 0; i[0] < N[0]; i[0]++) {
+        for(i[1] = 0; i[1] < N[1]; i[1]++)
+        {
+          C_dense[i[0]+i[1]*N[0]] *= beta;
+          for(k = 0; k < N[0]; k++)
+          {
+            C_dense[i[0]+i[1]*N[0]] += alpha*A_dense[i[0]+k*N[0]]*B_dense[k+i[1]*N[0]];
+          }
+        }
+      }
+
+#ifdef SGEMM
+      spamm_multiply(0.0, alpha, A, B, beta, C, (use_sgemm ? SGEMM : NULL), &flop, &memop);
+#else
+      spamm_multiply(0.0, alpha, A, B, beta, C, NULL, &flop, &memop);
+#endif
+
+      if(spamm_check(C, REL_TOLERANCE) != SPAMM_OK)
+      {
+        SPAMM_FATAL("failed\n");
+      }
+
+      for(i[0] = 0; i[0] < N[0]; i[0]++) {
+        for(i[1] = 0; i[1] < N[1]; i[1]++)
+        {
+          if(fabs((spamm_get_double(i, C)-C_dense[i[0]+i[1]*N[0]])/C_dense[i[0]+i[1]*N[0]]) > TEST_REL_TOLERANCE)
+          {
+            SPAMM_WARN("linear tree = %i, sgemm = %i: C(%u,%u) = %e, should be %e\n",
+                use_linear_tree, use_sgemm, i[0], i[1],
+                spamm_get_double(i, C), C_dense[i[0]+i[1]*N[0]]);
+            result = -1;
+          }
+        }
+      }
+
+      spamm_delete(&A);
+      spamm_delete(&B);
+      spamm_delete(&C);
+    }
+  }
+
+  free(A_dense);
+  free(B_dense);
+  free(C_dense);
+
+  return result;
+}
@@ -0,0 +1,196 @@
+#include "config.h"
+
+#include <spamm.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#define NUMBER_THREADS 4
+
+#define TEST_ABS_TOLERANCE 1e-6
+#define TEST_REL_TOLERANCE 1e-5
+
+/* Run a product with a given number of threads, and return C as a dense
+ * matrix. */
+float *
+multiply (const int number_threads,
+    const float tolerance,
+    const struct spamm_matrix_t *const A,
+    const struct spamm_matrix_t *const B,
+    const unsigned int *const N,
+    const unsigned int chunk_tier,
+    const short use_linear_tree,
+    double *const flop)
+{
+  double memop = 0;
+  float *C_dense;
+  struct spamm_matrix_t *C;
+
+#ifdef _OPENMP
+  omp_set_num_threads(number_threads);
+#endif
+
+  *flop = 0;
+  C = spamm_new(2, N, chunk_tier, use_linear_tree);
+  spamm_multiply(tolerance, 1.0, A, B, 0.0, C, NULL, flop, &memop);
+
+  if(spamm_check(C, 1e-8) != SPAMM_OK)
+  {
+    SPAMM_FATAL("failed\n");
+  }
+
+  C_dense = spamm_convert_spamm_to_dense(C);
+  spamm_delete(&C);
+
+  return C_dense;
+}
+
+/* Compare two dense matrices. */
+int
+compare (const char *const name,
+    const unsigned int *const N,
+    const float *const C_dense,
+    const float *const C_reference)
+{
+  int result = 0;
+  unsigned int i;
+
+  for(i = 0; i < N[0]*N[1]; i++)
+  {
+    if(fabs(C_dense[i]-C_reference[i]) > TEST_ABS_TOLERANCE
+        && fabs((C_dense[i]-C_reference[i])/C_reference[i]) > TEST_REL_TOLERANCE)
+    {
+      printf("%s: C(%u,%u) = %e, should be %e\n", name, i%N[0], i/N[0],
+          C_dense[i], C_reference[i]);
+      result = -1;
+      break;
+    }
+  }
+
+  return result;
+}
+
+int
+main ()
+{
+  int result = 0;
+
+  const unsigned int N[] = { 500, 500 };
+  const float tolerance[] = { 0, 1e-4 };
+
+  unsigned int i[2];
+  unsigned int k;
+  unsigned int chunk_tier;
+  unsigned int update;
+  short use_linear_tree;
+  short t;
+
+  double flop_serial;
+  double flop_threaded;
+
+  float *A_dense;
+  float *C_dense;
+  float *C_threaded;
+  float *C_reference;
+
+  struct spamm_matrix_t *A;
+
+  A_dense = calloc(N[0]*N[1], sizeof(float));
+  C_dense = calloc(N[0]*N[1], sizeof(float));
+
+  for(use_linear_tree = 0; use_linear_tree < 2; use_linear_tree++)
+  {
+    /* Large chunks give long streams in the linear tree, small ones many
+     * tasks in the hierarchical tree. */
+    chunk_tier = (use_linear_tree ? 1 : 3);
+
+    /* A matrix with exponential decay, so that a tolerance culls some of
+     * the products. */
+    srand(1);
+    for(i[0] = 0; i[0] < N[0]; i[0]++) {
+      for(i[1] = 0; i[1] < N[1]; i[1]++)
+      {
+        A_dense[i[0]+i[1]*N[0]] = rand()/(float) RAND_MAX
+          *exp(-fabs((double) i[0]-(double) i[1])/20.0);
+      }
+    }
+
+    A = spamm_convert_dense_to_spamm(2, N, chunk_tier, use_linear_tree,
+        column_major, A_dense);
+
+    /* The second pass changes an element after the first products, so the
+     * cached kernel block order of its chunk has to follow. */
+    for(update = 0; update < 2; update++)
+    {
+      if(update)
+      {
+        i[0] = 100;
+        i[1] = 300;
+        A_dense[i[0]+i[1]*N[0]] = 10.0;
+        spamm_set(i, A_dense[i[0]+i[1]*N[0]], A);
+      }
+
+      for(i[0] = 0; i[0] < N[0]; i[0]++) {
+        for(i[1] = 0; i[1] < N[1]; i[1]++)
+        {
+          C_dense[i[0]+i[1]*N[0]] = 0;
+          for(k = 0; k < N[0]; k++)
+          {
+            C_dense[i[0]+i[1]*N[0]] += A_dense[i[0]+k*N[0]]*A_dense[k+i[1]*N[0]];
+          }
+        }
+      }
+
+      for(t = 0; t < 2; t++)
+      {
+        C_reference = multiply(1, tolerance[t], A, A, N, chunk_tier,
+            use_linear_tree, &flop_serial);
+
+        /* Run the threaded product twice, the second one reuses the
+         * scratch buffers of the threads. */
+        for(k = 0; k < 2; k++)
+        {
+          C_threaded = multiply(NUMBER_THREADS, tolerance[t], A, A, N,
+              chunk_tier, use_linear_tree, &flop_threaded);
+
+          if(compare("threaded", N, C_threaded, C_reference))
+          {
+            printf("linear tree = %i, update = %u, tolerance = %e: threaded product differs from serial\n",
+                use_linear_tree, update, tolerance[t]);
+            result = -1;
+          }
+
+          if(flop_threaded != flop_serial)
+          {
+            printf("linear tree = %i, update = %u, tolerance = %e: %e flop threaded, %e flop serial\n",
+                use_linear_tree, update, tolerance[t], flop_threaded, flop_serial);
+            result = -1;
+          }
+
+          free(C_threaded);
+        }
+
+        if(tolerance[t] == 0 && compare("serial", N, C_reference, C_dense))
+        {
+          printf("linear tree = %i, update = %u: serial product differs from dense\n",
+              use_linear_tree, update);
+          result = -1;
+        }
+
+        free(C_reference);
+      }
+    }
+
+    spamm_delete(&A);
+  }
+
+  free(A_dense);
+  free(C_dense);
+
+  return result;
+}
@@ -0,0 +1,29 @@
+#!/bin/sh
+#
+# Run the linear tree multiply tests with the stream kernel given as the
+# first argument, see spamm_kernel_select(). The test is skipped if the CPU
+# or the build does not support the kernel.
+
+kernel=$1
+
+for test in 17_multiply_spamm 22_multiply_threads; do
+  case ${test} in
+    17_multiply_spamm) options="--linear --seed 1" ;;
+    *) options="" ;;
+  esac
+
+  output=`SPAMM_KERNEL=${kernel} ./${test} ${options} 2>&1`
+  result=$?
+
+  if echo "${output}" | grep "is not supported" > /dev/null; then
+    echo "${kernel} is not supported, skipping"
+    exit 77
+  fi
+
+  echo "${output}"
+
+  if test ${result} -ne 0; then
+    echo "${test} failed with ${kernel}"
+    exit 1
+  fi
+done
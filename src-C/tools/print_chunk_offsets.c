@@ -25,10 +25,12 @@ main (int argc, char **argv)
   unsigned int *N_pointer;
   unsigned int *N_lower_pointer;
   unsigned int *N_upper_pointer;
-  float *A_pointer;
+  void *A_pointer;
   float *A_dilated_pointer;
   spamm_norm_t *norm_pointer;
   spamm_norm_t *norm2_pointer;
+  unsigned int *index_A_pointer;
+  unsigned int *index_B_pointer;
 
   int dim;
 
@@ -87,9 +89,9 @@ main (int argc, char **argv)
   }
   chunk = spamm_new_chunk(number_dimensions, use_linear_tree, N, N_lower, N_upper);
   chunk_size = spamm_chunk_get_size_for_allocation(number_dimensions,
-      use_linear_tree, &number_tiers, N_lower, N_upper, &N_pointer,
+      use_linear_tree, single_precision, &number_tiers, N_lower, N_upper, &N_pointer,
       &N_lower_pointer, &N_upper_pointer, &A_pointer, &A_dilated_pointer,
-      &norm_pointer, &norm2_pointer);
+      &norm_pointer, &norm2_pointer, &index_A_pointer, &index_B_pointer);
 
   printf("number_dimensions = %u\n", number_dimensions);
   printf("N_contiguous      = %u\n", N_contiguous);
@@ -102,6 +104,7 @@ main (int argc, char **argv)
   printf("&chunk->number_dimensions = 0x%lx\n", (intptr_t) spamm_chunk_get_number_dimensions(chunk) - (intptr_t) chunk);
   printf("&chunk->number_tiers      = 0x%lx\n", (intptr_t) spamm_chunk_get_number_tiers(chunk) - (intptr_t) chunk);
   printf("&chunk->use_linear_tree   = 0x%lx\n", (intptr_t) spamm_chunk_get_use_linear_tree(chunk) - (intptr_t) chunk);
+  printf("&chunk->precision         = 0x%lx\n", (intptr_t) spamm_chunk_get_precision(chunk) - (intptr_t) chunk);
   printf("\n");
   printf("Chunk data - Pointer table\n");
   printf("N_pointer                 = 0x%lx\n", (intptr_t) 0*sizeof(void*)+4*sizeof(unsigned int));
@@ -111,6 +114,8 @@ main (int argc, char **argv)
   printf("A_dilated_pointer         = 0x%lx\n", (intptr_t) 4*sizeof(void*)+4*sizeof(unsigned int));
   printf("norm_pointer              = 0x%lx\n", (intptr_t) 5*sizeof(void*)+4*sizeof(unsigned int));
   printf("norm2_pointer             = 0x%lx\n", (intptr_t) 6*sizeof(void*)+4*sizeof(unsigned int));
+  printf("index_A_pointer           = 0x%lx\n", (intptr_t) 7*sizeof(void*)+4*sizeof(unsigned int));
+  printf("index_B_pointer           = 0x%lx\n", (intptr_t) 8*sizeof(void*)+4*sizeof(unsigned int));
   printf("\n");
   printf("Chunk data - data\n");
   printf("&chunk->N                 = 0x%lx\n", (intptr_t) spamm_chunk_get_N(chunk) - (intptr_t) chunk);
@@ -120,6 +125,8 @@ main (int argc, char **argv)
   printf("&chunk->A_dilated         = 0x%lx\n", (intptr_t) spamm_chunk_get_matrix_dilated(chunk) - (intptr_t) chunk);
   printf("&chunk->norm              = 0x%lx\n", (intptr_t) spamm_chunk_get_norm(chunk) - (intptr_t) chunk);
   printf("&chunk->norm2             = 0x%lx\n", (intptr_t) spamm_chunk_get_norm2(chunk) - (intptr_t) chunk);
+  printf("&chunk->index_A           = 0x%lx\n", (intptr_t) spamm_chunk_get_sorted_index_A(chunk) - (intptr_t) chunk);
+  printf("&chunk->index_B           = 0x%lx\n", (intptr_t) spamm_chunk_get_sorted_index_B(chunk) - (intptr_t) chunk);
 
   free(N);
   free(N_lower);
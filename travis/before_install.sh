@@ -4,3 +4,6 @@ sudo add-apt-repository ppa:ubuntu-toolchain-r/test -y
 sudo apt-get update -qq
 sudo apt-get autoremove -y
 sudo apt-get install -y gfortran-${GCC_VERSION}
+if test "${BUILD}" = "C"; then
+  sudo apt-get install -y autoconf automake libtool liblapack-dev python-dev
+fi
@@ -0,0 +1,14 @@
+#!/bin/bash -x
+
+cd src-C || exit
+chmod +x *.sh *.py src/*.py || exit
+./autogen.sh || exit
+./configure \
+  CC=${CC:=gcc-${GCC_VERSION}} \
+  FC=${FC:=gfortran-${GCC_VERSION}} \
+  LIBS="-llapack -lblas" \
+  ${CONFIGURE_FLAGS} \
+  || exit
+make -C src || exit
+make -C interfaces/Fortran || exit
+make -C tests check || { cat tests/test-suite.log; exit 1; }